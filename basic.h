@@ -97,6 +97,10 @@ static inline f32 approachf(f32 v, f32 step, f32 goal){
     return goal;
 }
 
+static inline f32 lerp(f32 v0, f32 v1, f32 t){
+    return (1.0f - t) * v0 + t * v1;
+}
+
 static inline i32 signi(i32 value){
     if(value > 0) return 1;
     if(value < 0) return -1;
@@ -120,7 +124,7 @@ static inline f32 length(f32 x, f32 y){
     return sqrtf(x * x + y * y);
 }
 
-static f32 dist(Vec2 a, Vec2 b){
+static inline f32 dist(Vec2 a, Vec2 b){
     return length(a.x - b.x, a.y - b.y);
 }
 
@@ -141,6 +145,37 @@ static inline void warpi(i32 *v, i32 min, i32 max){
     else if(*v > max) *v = min;
 }
 
+// ===================================================================
+// Bits
+// ===================================================================
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline i32 popcount32(u32 v){
+#if defined(_MSC_VER)
+    // __popcnt needs the instruction, this doesn't
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (i32)((((v + (v >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24);
+#else
+    return __builtin_popcount(v);
+#endif
+}
+
+// Index of the lowest set bit, 32 when v is 0
+static inline i32 ctz32(u32 v){
+    if(!v) return 32;
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return (i32)index;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
 
 // ===================================================================
 // Graphics
@@ -173,7 +208,11 @@ i32 random_in(i32 a, i32 b);
 u32 random_n(u32 max);
 
 #ifdef BASIC_IMPLEMENT
+#if defined(_MSC_VER)
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 u64 _RNGSeed = 0;
 u64 _RNGinitSeed = 0;
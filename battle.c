@@ -0,0 +1,327 @@
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+#include "bot.h"
+#include "battle.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BATTLE_SSE2 1
+#endif
+
+// Garbage sent for 1, 2, 3 and 4 lines
+static const i32 GarbageForLines[5] = {0, 0, 1, 2, 4};
+
+static u64 battle_random(u64 *rng){
+    *rng += 0x9e3779b97f4a7c15;
+    u64 z = *rng;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static void reset_board(BattleBoards *battle, i32 i){
+    i32 stride = battle->stride;
+    for(i32 y = 0; y < GridH; y++)
+        battle->rows[y * stride + i] = GridWallMask;
+    piece_randomizer_init(&battle->randomizer[i], battle_random(&battle->rng[i]) | 1);
+    battle->next_piece[i] = piece_randomizer_next(&battle->randomizer[i]);
+    battle->needs_piece[i] = true;
+    battle->dead[i] = false;
+    // the first spawn waits up to one gravity step, so boards that start
+    // together don't all run their policy on the same tick
+    battle->gravity[i] = -(i32)(battle_random(&battle->rng[i]) % SIM_MOVE_DOWN_TICKS);
+    battle->pending[i] = 0;
+    battle->sent[i] = 0;
+}
+
+b32 battle_init(BattleBoards *battle, i32 count, i32 policy, u64 seed){
+    set_zero(battle, sizeof(*battle));
+    battle->count  = count;
+    battle->stride = (count + BATTLE_LANES - 1) / BATTLE_LANES * BATTLE_LANES;
+    battle->policy = policy;
+
+    i32 n = battle->stride;
+    battle->rows        = calloc((size_t)n * GridH, sizeof(*battle->rows));
+    battle->full_rows   = calloc(n, sizeof(*battle->full_rows));
+    battle->gravity     = calloc(n, sizeof(*battle->gravity));
+    battle->x           = calloc(n, sizeof(*battle->x));
+    battle->y           = calloc(n, sizeof(*battle->y));
+    battle->piece       = calloc(n, sizeof(*battle->piece));
+    battle->next_piece  = calloc(n, sizeof(*battle->next_piece));
+    battle->needs_piece = calloc(n, sizeof(*battle->needs_piece));
+    battle->dead        = calloc(n, sizeof(*battle->dead));
+    battle->pending     = calloc(n, sizeof(*battle->pending));
+    battle->sent        = calloc(n, sizeof(*battle->sent));
+    battle->rng         = calloc(n, sizeof(*battle->rng));
+    battle->randomizer  = calloc(n, sizeof(*battle->randomizer));
+    battle->score       = calloc(n, sizeof(*battle->score));
+    battle->lines       = calloc(n, sizeof(*battle->lines));
+    battle->pieces      = calloc(n, sizeof(*battle->pieces));
+    battle->garbage     = calloc(n, sizeof(*battle->garbage));
+    battle->wins        = calloc(n, sizeof(*battle->wins));
+    battle->games       = calloc(n, sizeof(*battle->games));
+
+    if(!battle->rows || !battle->full_rows || !battle->gravity || !battle->x || !battle->y ||
+       !battle->piece || !battle->next_piece || !battle->needs_piece || !battle->dead ||
+       !battle->pending || !battle->sent || !battle->rng || !battle->randomizer || !battle->score ||
+       !battle->lines || !battle->pieces || !battle->garbage || !battle->wins || !battle->games){
+        battle_free(battle);
+        return false;
+    }
+
+    u64 stream = seed;
+    for(i32 i = 0; i < n; i++){
+        battle->rng[i] = battle_random(&stream);
+        reset_board(battle, i);
+        if(i >= count) battle->dead[i] = true; // padding, stays empty and never spawns
+    }
+    return true;
+}
+
+void battle_free(BattleBoards *battle){
+    free(battle->rows);
+    free(battle->full_rows);
+    free(battle->gravity);
+    free(battle->x);
+    free(battle->y);
+    free(battle->piece);
+    free(battle->next_piece);
+    free(battle->needs_piece);
+    free(battle->dead);
+    free(battle->pending);
+    free(battle->sent);
+    free(battle->rng);
+    free(battle->randomizer);
+    free(battle->score);
+    free(battle->lines);
+    free(battle->pieces);
+    free(battle->garbage);
+    free(battle->wins);
+    free(battle->games);
+    set_zero(battle, sizeof(*battle));
+}
+
+// Pushes the stack up and fills the bottom with one hole per batch,
+// returns false if blocks were pushed out of the top
+static b32 add_garbage(BattleBoards *battle, i32 i, i32 lines){
+    i32 stride = battle->stride;
+    u16 *rows = battle->rows + i;
+    b32 topped_out = false;
+    for(i32 y = 0; y < lines; y++)
+        topped_out |= rows[y * stride] != GridWallMask;
+
+    for(i32 y = 0; y < GridH - lines; y++)
+        rows[y * stride] = rows[(y + lines) * stride];
+    u16 hole = (u16)(1 << ((i32)(battle_random(&battle->rng[i]) % GridW) + GridPad));
+    for(i32 y = GridH - lines; y < GridH; y++)
+        rows[y * stride] = (u16)(GridRowFull & ~hole);
+
+    battle->garbage[i] += lines;
+    return !topped_out;
+}
+
+static void choose_placement(BattleBoards *battle, i32 i, PlacementSearch *search){
+    i32 stride = battle->stride;
+    Board board = {0};
+    for(i32 y = 0; y < GridH; y++)
+        board.rows[y] = battle->rows[y * stride + i];
+    board_update_counters(&board);
+
+    i32 count = find_placements(search, &board, battle->piece[i], battle->x[i], battle->y[i]);
+    if(!count) return;
+
+    i32 best = 0;
+    if(battle->policy == BATTLE_POLICY_RANDOM){
+        best = (i32)(battle_random(&battle->rng[i]) % (u64)count);
+    } else {
+        f32 best_score = 0;
+        for(i32 p = 0; p < count; p++){
+            const Placement *placement = &search->placements[p];
+            Board next = board;
+            u32 full = board_set_piece(&next, placement->x, placement->y, placement->piece);
+            board_remove_rows(&next, full);
+            f32 score = bot_evaluate(&BotDefaultWeights, &next, popcount32(full));
+            if(p == 0 || score > best_score){
+                best = p;
+                best_score = score;
+            }
+        }
+    }
+
+    const Placement *placement = &search->placements[best];
+    battle->x[i] = placement->x;
+    battle->y[i] = placement->y;
+    battle->piece[i] = placement->piece;
+}
+
+static void spawn_piece(BattleBoards *battle, i32 i, PlacementSearch *search){
+    if(battle->pending[i]){
+        i32 lines = MIN(battle->pending[i], GridH);
+        battle->pending[i] = 0;
+        if(!add_garbage(battle, i, lines)){
+            battle->dead[i] = true;
+            return;
+        }
+    }
+
+    Piece piece = battle->next_piece[i];
+    battle->next_piece[i] = piece_randomizer_next(&battle->randomizer[i]);
+    battle->piece[i] = piece;
+    battle->x[i] = (i8)piece_spawn_x(piece);
+    battle->y[i] = 0;
+    battle->gravity[i] = 0;
+    battle->needs_piece[i] = false;
+    battle->pieces[i]++;
+
+    if(rows_piece_collided(battle->rows + i, battle->stride, battle->x[i], battle->y[i], piece)){
+        battle->dead[i] = true;
+        return;
+    }
+    choose_placement(battle, i, search);
+}
+
+static void drop_piece(BattleBoards *battle, i32 i){
+    battle->gravity[i] = 0;
+    if(battle->dead[i] || battle->needs_piece[i]) return;
+
+    i32 stride = battle->stride;
+    Piece piece = battle->piece[i];
+    i32 x = battle->x[i];
+    i32 y = battle->y[i];
+    if(!rows_piece_collided(battle->rows + i, stride, x, y + 1, piece)){
+        battle->y[i] = (i8)(y + 1);
+        return;
+    }
+
+    const PieceShape *shape = piece_shape(piece);
+    for(i32 r = shape->box.y; r < shape->box.y + shape->box.h; r++){
+        if(y + r < 0) continue;
+        battle->rows[(y + r) * stride + i] |= (u16)(shape->rows[r] << (x + GridPad));
+    }
+    battle->needs_piece[i] = true;
+}
+
+// Same compaction as board_remove_rows, down one board's column of rows
+static void clear_rows(BattleBoards *battle, i32 i, u32 mask){
+    i32 stride = battle->stride;
+    u16 *rows = battle->rows + i;
+    i32 write = GridH - 1;
+    for(i32 y = GridH - 1; y >= 0; y--){
+        if(mask & (1u << y)) continue;
+        rows[write * stride] = rows[y * stride];
+        write--;
+    }
+    for(; write >= 0; write--)
+        rows[write * stride] = GridWallMask;
+
+    i32 lines = popcount32(mask);
+    battle->score[i] += lines * SIM_LINE_SCORE;
+    battle->lines[i] += lines;
+    battle->sent[i]  += GarbageForLines[MIN(lines, 4)];
+}
+
+// One server tick for boards [begin, end), begin must be a multiple of
+// BATTLE_LANES. Chunks don't share any board so they can run in parallel.
+void battle_step(BattleBoards *battle, i32 begin, i32 end, PlacementSearch *search){
+    assert(begin % BATTLE_LANES == 0 && end <= battle->count);
+    i32 stride = battle->stride;
+    i32 lane_end = MIN((end + BATTLE_LANES - 1) / BATTLE_LANES * BATTLE_LANES, stride);
+
+    // Spawns, garbage and the policy, only boards that locked last tick
+    for(i32 i = begin; i < end; i++){
+        if(battle->needs_piece[i] && !battle->dead[i] && battle->gravity[i] >= 0)
+            spawn_piece(battle, i, search);
+    }
+
+    // Gravity
+#if BATTLE_SSE2
+    const __m128i step  = _mm_set1_epi32(BATTLE_SIM_TICKS);
+    const __m128i limit = _mm_set1_epi32(SIM_MOVE_DOWN_TICKS - 1);
+    for(i32 i = begin; i < lane_end; i += 4){
+        __m128i *gravity = (__m128i *)&battle->gravity[i];
+        __m128i g = _mm_add_epi32(_mm_loadu_si128(gravity), step);
+        _mm_storeu_si128(gravity, g);
+        u32 due = (u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(g, limit)));
+        for(; due; due &= due - 1)
+            drop_piece(battle, i + ctz32(due));
+    }
+#else
+    for(i32 i = begin; i < lane_end; i++){
+        battle->gravity[i] += BATTLE_SIM_TICKS;
+        if(battle->gravity[i] >= SIM_MOVE_DOWN_TICKS)
+            drop_piece(battle, i);
+    }
+#endif
+
+    // Full rows, one u32 row mask per board built a row of boards at a time
+#if BATTLE_SSE2
+    const __m128i full = _mm_set1_epi16((i16)GridRowFull);
+    const __m128i zero = _mm_setzero_si128();
+    for(i32 i = begin; i < lane_end; i += 8){
+        __m128i lo = zero; // boards i to i + 3
+        __m128i hi = zero; // boards i + 4 to i + 7
+        for(i32 y = 0; y < GridH; y++){
+            __m128i eq  = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&battle->rows[y * stride + i]), full);
+            __m128i bit = _mm_set1_epi32(1 << y);
+            lo = _mm_or_si128(lo, _mm_and_si128(_mm_unpacklo_epi16(eq, eq), bit));
+            hi = _mm_or_si128(hi, _mm_and_si128(_mm_unpackhi_epi16(eq, eq), bit));
+        }
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_or_si128(lo, hi), zero)) == 0xffff)
+            continue;
+        _mm_storeu_si128((__m128i *)&battle->full_rows[i], lo);
+        _mm_storeu_si128((__m128i *)&battle->full_rows[i + 4], hi);
+        for(i32 k = i; k < i + 8; k++){
+            if(battle->full_rows[k]) clear_rows(battle, k, battle->full_rows[k]);
+        }
+    }
+#else
+    for(i32 i = begin; i < lane_end; i++)
+        battle->full_rows[i] = 0;
+    for(i32 y = 0; y < GridH; y++){
+        const u16 *rows = &battle->rows[y * stride];
+        for(i32 i = begin; i < lane_end; i++)
+            battle->full_rows[i] |= (u32)(rows[i] == GridRowFull) << y;
+    }
+    for(i32 i = begin; i < lane_end; i++){
+        if(battle->full_rows[i]) clear_rows(battle, i, battle->full_rows[i]);
+    }
+#endif
+}
+
+// Runs once per tick after every chunk stepped. Garbage first cancels what
+// is waiting on the sender, then finished pairs are scored and restarted.
+void battle_route_garbage(BattleBoards *battle){
+    for(i32 i = 0; i < battle->count; i++){
+        i32 sent = battle->sent[i];
+        battle->sent[i] = 0;
+        if(!sent) continue;
+
+        i32 cancel = MIN(sent, battle->pending[i]);
+        battle->pending[i] -= cancel;
+        sent -= cancel;
+
+        i32 opponent = i ^ 1;
+        if(sent && opponent < battle->count)
+            battle->pending[opponent] = MIN(battle->pending[opponent] + sent, GridH);
+    }
+
+    for(i32 i = 0; i < battle->count; i += 2){
+        i32 opponent = i + 1;
+        b32 has_opponent = opponent < battle->count;
+        b32 lost = battle->dead[i];
+        b32 opponent_lost = has_opponent && battle->dead[opponent];
+        if(!lost && !opponent_lost) continue;
+
+        if(has_opponent && !lost) battle->wins[i]++;
+        if(has_opponent && !opponent_lost) battle->wins[opponent]++;
+        battle->games[i]++;
+        reset_board(battle, i);
+        if(has_opponent){
+            battle->games[opponent]++;
+            reset_board(battle, opponent);
+        }
+    }
+}
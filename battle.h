@@ -0,0 +1,61 @@
+#pragma once
+
+// Thousands of boards stepped together for the headless battle server.
+// Boards are stored structure of arrays, row y of board i is
+// rows[y * stride + i], so the per tick passes (gravity, full row
+// detection) are vector loops across boards and only the boards that
+// actually moved, locked or cleared drop to scalar code.
+//
+// Boards play in pairs, 2k against 2k + 1. Cleared lines first cancel the
+// garbage waiting on the board and the rest goes to the opponent. When a
+// board tops out the pair is scored and both start over.
+//
+// Same pieces, collision, gravity and line score as simulation.c. Pieces
+// go straight to the lock position their policy picked and then fall on
+// normal gravity, and there's no tetris pause.
+
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+
+#define BATTLE_TICK_RATE  60
+#define BATTLE_SIM_TICKS  (SIM_TICK_RATE / BATTLE_TICK_RATE) // gravity ticks per server tick
+#define BATTLE_LANES      8 // boards per vector, stride and chunks are multiples of it
+
+enum BattlePolicy{
+    BATTLE_POLICY_RANDOM,
+    BATTLE_POLICY_GREEDY,
+};
+
+typedef struct{
+    i32 count;
+    i32 stride; // count rounded up to BATTLE_LANES, the padding boards never play
+    i32 policy;
+
+    u16 *rows;      // [GridH][stride]
+    u32 *full_rows; // scratch for the line pass
+    i32 *gravity;    // negative while waiting for the first spawn
+    i8 *x;
+    i8 *y;
+    Piece *piece;
+    Piece *next_piece;
+    u8 *needs_piece; // spawn before the next gravity pass
+    u8 *dead;
+    i32 *pending;    // garbage lines waiting, added before the next spawn
+    i32 *sent;       // garbage made this tick, see battle_route_garbage
+    u64 *rng;        // garbage holes and reseeding
+    PieceRandomizer *randomizer;
+
+    // per board totals since battle_init, summed by the caller
+    i32 *score;
+    i32 *lines;
+    i32 *pieces;
+    i32 *garbage;
+    i32 *wins;
+    i32 *games;
+}BattleBoards;
+
+b32 battle_init(BattleBoards *battle, i32 count, i32 policy, u64 seed);
+void battle_free(BattleBoards *battle);
+void battle_step(BattleBoards *battle, i32 begin, i32 end, PlacementSearch *search);
+void battle_route_garbage(BattleBoards *battle);
@@ -0,0 +1,167 @@
+// Headless battle server: steps thousands of paired boards per tick on
+// every core and reports how long each tick took. Build with
+// build_linux.sh.
+//
+//   battle_server [-b boards] [-t threads] [-n ticks] [-p random|greedy] [-s seed] [-r]
+//
+// -r paces the ticks at BATTLE_TICK_RATE like a live server would,
+// otherwise ticks run back to back to find the throughput.
+
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+#include "jobs.h"
+#include "battle.h"
+
+#include <string.h>
+#include <time.h>
+
+#define BATTLE_CHUNK 256 // boards per job, a multiple of BATTLE_LANES
+
+typedef struct{
+    BattleBoards *battle;
+    PlacementSearch *searches; // one per worker
+    i32 begin, end;
+}ChunkJob;
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+static void sleep_until(f64 deadline){
+    f64 now = wall_seconds();
+    if(now >= deadline) return;
+    f64 wait = deadline - now;
+    struct timespec t = {.tv_sec = (time_t)wait, .tv_nsec = (long)((wait - (f64)(time_t)wait) * 1e9)};
+    nanosleep(&t, NULL);
+}
+
+static void chunk_job(JobPool *pool, i32 worker, void *data){
+    (void)pool;
+    ChunkJob *job = data;
+    battle_step(job->battle, job->begin, job->end, &job->searches[worker]);
+}
+
+static i32 compare_f64(const void *a, const void *b){
+    f64 x = *(const f64 *)a, y = *(const f64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(void){
+    printf("usage: battle_server [-b boards] [-t threads] [-n ticks] [-p random|greedy] [-s seed] [-r]\n");
+}
+
+int main(int argc, char **argv){
+    i32 boards = 10000;
+    i32 threads = job_cpu_count();
+    i32 ticks = 600;
+    i32 policy = BATTLE_POLICY_GREEDY;
+    u64 seed = 1;
+    b32 realtime = false;
+
+    for(i32 i = 1; i < argc; i++){
+        const char *arg = argv[i];
+        if(strcmp(arg, "-r") == 0){
+            realtime = true;
+            continue;
+        }
+        const char *value = i + 1 < argc? argv[i + 1] : NULL;
+        if(!value || arg[0] != '-' || strlen(arg) != 2){
+            usage();
+            return 1;
+        }
+        switch(arg[1]){
+            case 'b': boards = atoi(value); break;
+            case 't': threads = atoi(value); break;
+            case 'n': ticks = atoi(value); break;
+            case 's': seed = strtoull(value, NULL, 0); break;
+            case 'p':
+                if(strcmp(value, "random") == 0)      policy = BATTLE_POLICY_RANDOM;
+                else if(strcmp(value, "greedy") == 0) policy = BATTLE_POLICY_GREEDY;
+                else { usage(); return 1; }
+                break;
+            default: usage(); return 1;
+        }
+        i++;
+    }
+    boards = MAX(boards, 2);
+    ticks = MAX(ticks, 1);
+    threads = MAX(1, MIN(threads, JOB_MAX_WORKERS));
+
+    static BattleBoards battle;
+    if(!battle_init(&battle, boards, policy, seed)){
+        printf("Can't allocate %d boards\n", boards);
+        return 1;
+    }
+
+    i32 chunk_count = (boards + BATTLE_CHUNK - 1) / BATTLE_CHUNK;
+    ChunkJob *chunks = calloc(chunk_count, sizeof(*chunks));
+    PlacementSearch *searches = calloc(threads, sizeof(*searches));
+    f64 *tick_times = calloc(ticks, sizeof(*tick_times));
+    if(!chunks || !searches || !tick_times){
+        printf("Out of memory\n");
+        return 1;
+    }
+    for(i32 c = 0; c < chunk_count; c++){
+        chunks[c].battle = &battle;
+        chunks[c].searches = searches;
+        chunks[c].begin = c * BATTLE_CHUNK;
+        chunks[c].end = MIN(boards, (c + 1) * BATTLE_CHUNK);
+    }
+
+    static JobPool pool;
+    job_pool_init(&pool, threads);
+
+    const f64 budget = 1.0 / BATTLE_TICK_RATE;
+    f64 start = wall_seconds();
+    f64 deadline = start;
+    for(i32 tick = 0; tick < ticks; tick++){
+        if(realtime){
+            deadline += budget;
+            sleep_until(deadline - budget);
+        }
+        f64 tick_start = wall_seconds();
+        for(i32 c = 0; c < chunk_count; c++)
+            job_push(&pool, 0, chunk_job, &chunks[c]);
+        job_pool_wait(&pool, 0);
+        battle_route_garbage(&battle);
+        tick_times[tick] = wall_seconds() - tick_start;
+    }
+    f64 seconds = wall_seconds() - start;
+    job_pool_shutdown(&pool);
+
+    i64 pieces = 0, lines = 0, garbage = 0, games = 0;
+    for(i32 i = 0; i < boards; i++){
+        pieces  += battle.pieces[i];
+        lines   += battle.lines[i];
+        garbage += battle.garbage[i];
+        games   += battle.games[i];
+    }
+
+    f64 total = 0;
+    i32 over_budget = 0;
+    for(i32 i = 0; i < ticks; i++){
+        total += tick_times[i];
+        over_budget += tick_times[i] > budget;
+    }
+    qsort(tick_times, ticks, sizeof(*tick_times), compare_f64);
+
+    printf("%d boards, %s policy, %d threads, %d ticks in %.3fs%s\n", boards, policy == BATTLE_POLICY_RANDOM? "random" : "greedy",
+        threads, ticks, seconds, realtime? " (paced)" : "");
+    printf("ticks/sec        %.1f (target %d)\n", ticks / seconds, BATTLE_TICK_RATE);
+    printf("board ticks/sec  %.0f\n", (f64)boards * ticks / seconds);
+    printf("tick ms          avg %.3f  min %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+        total / ticks * 1e3, tick_times[0] * 1e3, tick_times[ticks / 2] * 1e3,
+        tick_times[MIN(ticks - 1, ticks * 99 / 100)] * 1e3, tick_times[ticks - 1] * 1e3);
+    printf("over %.1f ms      %d ticks\n", budget * 1e3, over_budget);
+    printf("pieces %lld, lines %lld, garbage received %lld, games finished %lld\n",
+        (long long)pieces, (long long)lines, (long long)garbage, (long long)(games / 2));
+
+    battle_free(&battle);
+    free(chunks);
+    free(searches);
+    free(tick_times);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Line clear micro benchmark: the old per cell scan plus one cascade per
+// cleared line against board_full_rows + board_remove_rows. Both run on
+// the same boards and their results are compared before timing.
+//
+//   bench_lines [iterations]
+
+#include "basic.h"
+#include "simulation.h"
+
+#include <string.h>
+#include <time.h>
+
+#define BOARD_SET_SIZE 1024
+
+static u64 Rng = 0x2545f4914f6cdd1d;
+
+static u64 bench_random(void){
+    Rng += 0x9e3779b97f4a7c15;
+    u64 z = Rng;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+// What update_grid did before: test every cell, then shift everything
+// above each cleared line down by one, once per line
+static i32 clear_lines_cascade(Board *board){
+    i32 queue[GridH];
+    i32 count = 0;
+    for(i32 y = 0; y < GridH; y++){
+        b32 full = true;
+        for(i32 x = 0; x < GridW; x++){
+            if(!board->colors[y][x]){
+                full = false;
+                break;
+            }
+        }
+        if(full) queue[count++] = y;
+    }
+
+    for(i32 i = 0; i < count; i++){
+        for(i32 y = queue[i]; y > 0; y--){
+            board->rows[y] = board->rows[y - 1];
+            memcpy(board->colors[y], board->colors[y - 1], sizeof(board->colors[y]));
+        }
+        board->rows[0] = GridWallMask;
+        set_zero(board->colors[0], sizeof(board->colors[0]));
+    }
+    return count;
+}
+
+// Stack of rows, each filled with the given chance, full_rows of them
+// forced full at random heights
+static void random_board(Board *board, i32 stack, u32 fill_percent, i32 full_rows){
+    board_clear(board);
+    for(i32 y = GridH - stack; y < GridH; y++){
+        for(i32 x = 0; x < GridW; x++){
+            if(bench_random() % 100 < fill_percent)
+                board_set_cell(board, x, y, 1 + (i32)(bench_random() % PIECE_COUNT));
+        }
+        board_set_cell(board, (i32)(bench_random() % GridW), y, 0); // never full by chance
+    }
+    for(i32 i = 0; i < full_rows; i++){
+        i32 y = GridH - 1 - (i32)(bench_random() % (u64)stack);
+        for(i32 x = 0; x < GridW; x++)
+            board_set_cell(board, x, y, 1 + (i32)(bench_random() % PIECE_COUNT));
+    }
+}
+
+static Board Boards[BOARD_SET_SIZE];
+static Board Work[BOARD_SET_SIZE];
+
+static f64 run(i32 iterations, b32 cascade, i64 *lines){
+    *lines = 0;
+    f64 start = wall_seconds();
+    for(i32 it = 0; it < iterations; it++){
+        memcpy(Work, Boards, sizeof(Boards));
+        for(i32 i = 0; i < BOARD_SET_SIZE; i++)
+            *lines += cascade? clear_lines_cascade(&Work[i]) : board_clear_lines(&Work[i]);
+    }
+    return wall_seconds() - start;
+}
+
+static void bench(const char *name, i32 iterations, i32 stack, u32 fill_percent, i32 full_rows){
+    for(i32 i = 0; i < BOARD_SET_SIZE; i++)
+        random_board(&Boards[i], stack, fill_percent, full_rows);
+
+    for(i32 i = 0; i < BOARD_SET_SIZE; i++){
+        Board a = Boards[i], b = Boards[i];
+        i32 lines_a = clear_lines_cascade(&a);
+        i32 lines_b = board_clear_lines(&b);
+        b32 same = memcmp(a.rows, b.rows, sizeof(a.rows)) == 0 && memcmp(a.colors, b.colors, sizeof(a.colors)) == 0;
+        if(lines_a != lines_b || !same){
+            printf("%s: board %d differs!\n", name, i);
+            exit(1);
+        }
+    }
+
+    // the copy is in both timings, time it alone to take it out
+    f64 copy = wall_seconds();
+    for(i32 it = 0; it < iterations; it++) memcpy(Work, Boards, sizeof(Boards));
+    copy = wall_seconds() - copy;
+
+    i64 lines_old, lines_new;
+    f64 t_old = run(iterations, true, &lines_old) - copy;
+    f64 t_new = run(iterations, false, &lines_new) - copy;
+    f64 boards = (f64)iterations * BOARD_SET_SIZE;
+    printf("%-7s %6.2f lines/board  cascade %7.1f ns  compact %7.1f ns  %5.2fx\n",
+        name, (f64)lines_new / boards, t_old / boards * 1e9, t_new / boards * 1e9, t_old / t_new);
+}
+
+int main(int argc, char **argv){
+    i32 iterations = argc > 1? atoi(argv[1]) : 2000;
+    iterations = MAX(iterations, 1);
+
+    bench("sparse", iterations, 6, 30, 0);
+    bench("mixed", iterations, 12, 70, 1);
+    bench("dense", iterations, GridH - 2, 90, 4);
+    return 0;
+}
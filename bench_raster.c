@@ -0,0 +1,251 @@
+// Software rasterizer benchmark: draws a frame shaped like a busy game
+// frame (tiled background, board, text, overlays) with raster.c, first on
+// one thread and then tiled over the job pool, and checks both give the
+// same pixels. Run it from the repo root, it loads data/tile_sprite.png.
+//
+//   bench_raster [-n frames] [-t threads] [-d divisor]
+//
+// -d renders at the window size divided by it, 4 is thumbnail size.
+
+#include "basic.h"
+#include "jobs.h"
+#include "raster.h"
+
+#include <string.h>
+#include <time.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define WINDOW_W   800 // WWIDTH and WHEIGHT of the game
+#define WINDOW_H   600
+#define ATLAS_SIZE 1024
+#define BLOCK      25
+
+typedef struct{
+    Vertex *vertices;
+    SpriteInstance *instances;
+    VertexRange *ranges;
+    RenderBatch *batches;
+    RenderFrame frame;
+}BenchFrame;
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+// What set_default_uniforms in renderer.c gives
+static void default_uniforms(Uniforms *uniforms){
+    set_zero(uniforms, sizeof(*uniforms));
+    for(i32 i = 0; i < 4; i++) uniforms->ident_matrix[i][i] = 1.0f;
+    for(i32 i = 0; i < 3; i++) uniforms->uv_matrix[i][i] = 1.0f;
+    uniforms->translation_matrix[0][0] = 2.0f / WINDOW_W;
+    uniforms->translation_matrix[0][3] = -1.0f;
+    uniforms->translation_matrix[1][1] = -2.0f / WINDOW_H;
+    uniforms->translation_matrix[1][3] = 1.0f;
+    uniforms->translation_matrix[2][2] = 1.0f;
+    uniforms->translation_matrix[3][3] = 1.0f;
+}
+
+static u32 rgba(u8 r, u8 g, u8 b, u8 a){
+    return (u32)r | ((u32)g << 8) | ((u32)b << 16) | ((u32)a << 24);
+}
+
+static RenderBatch *begin_batch(BenchFrame *f, i32 type, b32 textured, u32 texture, const Uniforms *uniforms){
+    RenderFrame *frame = &f->frame;
+    RenderBatch *batch = &f->batches[frame->batch_count++];
+    *batch = (RenderBatch){
+        .type = type,
+        .textured = textured,
+        .texture = texture,
+        .uniforms = uniforms,
+        .first = type == DRAW_SPRITE? frame->instance_count : frame->range_count,
+    };
+    if(type == DRAW_TRIANGLE)
+        f->ranges[frame->range_count] = (VertexRange){frame->vertex_count, 0};
+    return batch;
+}
+
+static void end_batch(BenchFrame *f, RenderBatch *batch){
+    RenderFrame *frame = &f->frame;
+    if(batch->type == DRAW_SPRITE){
+        batch->count = frame->instance_count - batch->first;
+    } else{
+        f->ranges[frame->range_count].count = frame->vertex_count - f->ranges[frame->range_count].first;
+        frame->range_count++;
+        batch->count = 1;
+    }
+}
+
+static void sprite(BenchFrame *f, i32 x, i32 y, i32 ax, i32 ay, i32 w, i32 h, u32 color){
+    f->instances[f->frame.instance_count++] = (SpriteInstance){
+        .position = {(i16)x, (i16)y},
+        .atlas_rect = {(u16)ax, (u16)ay, (u16)w, (u16)h},
+        .color = color,
+    };
+}
+
+static void vertex(BenchFrame *f, i32 x, i32 y, f32 u, f32 v, u32 color){
+    f->vertices[f->frame.vertex_count++] = (Vertex){
+        .position = {(i16)x, (i16)y},
+        .texture_coord = {(u16)(u * 65535.0f + .5f), (u16)(v * 65535.0f + .5f)},
+        .color = color,
+    };
+}
+
+static void quad(BenchFrame *f, i32 x, i32 y, i32 w, i32 h, f32 u0, f32 v0, f32 u1, f32 v1, const u32 color[4]){
+    vertex(f, x, y, u0, v1, color[0]);
+    vertex(f, x + w, y, u1, v1, color[1]);
+    vertex(f, x, y + h, u0, v0, color[2]);
+    vertex(f, x, y + h, u0, v0, color[2]);
+    vertex(f, x + w, y, u1, v1, color[1]);
+    vertex(f, x + w, y + h, u1, v0, color[3]);
+}
+
+// Same batches every run, in the order the renderer's sort would give
+static void build_frame(BenchFrame *f, const Uniforms *uniforms, u32 atlas){
+    static const u32 piece_colors[7] = {
+        0xff3030e0, 0xff30e0e0, 0xffe0e030, 0xff30e030, 0xffe03030, 0xffe030e0, 0xff3080f0,
+    };
+    RenderFrame *frame = &f->frame;
+    *frame = (RenderFrame){
+        .clear = true,
+        .clear_color = rgba(26, 26, 26, 0),
+        .vertices = f->vertices,
+        .instances = f->instances,
+        .ranges = f->ranges,
+        .batches = f->batches,
+    };
+
+    // background, dim tiles over the whole window
+    RenderBatch *batch = begin_batch(f, DRAW_SPRITE, true, atlas, uniforms);
+    for(i32 y = 0; y < WINDOW_H; y += BLOCK)
+        for(i32 x = 0; x < WINDOW_W; x += BLOCK)
+            sprite(f, x, y, BLOCK, 0, BLOCK, BLOCK, rgba(60, 60, 70, 255));
+    end_batch(f, batch);
+
+    // board: border, settled cells and the falling piece
+    const i32 board_x = (WINDOW_W / BLOCK - 10) / 2 * BLOCK, board_y = BLOCK;
+    batch = begin_batch(f, DRAW_SPRITE, true, atlas, uniforms);
+    for(i32 y = -1; y <= 20; y++){
+        sprite(f, board_x - BLOCK, board_y + y * BLOCK, 0, 0, BLOCK, BLOCK, 0xffffffff);
+        sprite(f, board_x + 10 * BLOCK, board_y + y * BLOCK, 0, 0, BLOCK, BLOCK, 0xffffffff);
+    }
+    for(i32 y = 8; y < 20; y++)
+        for(i32 x = 0; x < 10; x++)
+            if((x * 7 + y * 3) % 5)
+                sprite(f, board_x + x * BLOCK, board_y + y * BLOCK, BLOCK, 0, BLOCK, BLOCK, piece_colors[(x + y) % 7]);
+    for(i32 i = 0; i < 4; i++)
+        sprite(f, board_x + (4 + i) * BLOCK, board_y + 2 * BLOCK + 7, BLOCK, 0, BLOCK, BLOCK, piece_colors[2]);
+    end_batch(f, batch);
+
+    // text, glyph sized sprites in rows like the statistics panel
+    batch = begin_batch(f, DRAW_SPRITE, true, atlas, uniforms);
+    for(i32 line = 0; line < 24; line++)
+        for(i32 c = 0; c < 40; c++)
+            sprite(f, 20 + c * 9 + (line & 1) * 400, 40 + line * 22, (c * 5) % 60, 3 + c % 8, 8, 14, rgba(255, 255, 120, 255));
+    end_batch(f, batch);
+
+    // a scaled sprite, textured vertices like draw_sprite with scale != 1
+    batch = begin_batch(f, DRAW_TRIANGLE, true, atlas, uniforms);
+    const u32 white[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    quad(f, 620, 400, 150, 50, 0.0f, 1.0f - 25.0f / ATLAS_SIZE, 75.0f / ATLAS_SIZE, 1.0f, white);
+    end_batch(f, batch);
+
+    // overlay: translucent rect over everything and a shaded panel
+    batch = begin_batch(f, DRAW_TRIANGLE, false, 0, uniforms);
+    const u32 shade[4] = {rgba(0, 0, 0, 77), rgba(0, 0, 0, 77), rgba(0, 0, 0, 77), rgba(0, 0, 0, 77)};
+    quad(f, 0, 0, WINDOW_W, WINDOW_H, 0, 0, 0, 0, shade);
+    const u32 panel[4] = {rgba(200, 40, 40, 200), rgba(40, 200, 40, 200), rgba(40, 40, 200, 200), rgba(200, 200, 40, 200)};
+    quad(f, 250, 200, 300, 120, 0, 0, 0, 0, panel);
+    end_batch(f, batch);
+}
+
+static f64 run(Raster *raster, const RenderFrame *frame, i32 frames){
+    f64 start = wall_seconds();
+    for(i32 i = 0; i < frames; i++)
+        raster_draw_frame(raster, frame);
+    return wall_seconds() - start;
+}
+
+static void usage(void){
+    printf("usage: bench_raster [-n frames] [-t threads] [-d divisor]\n");
+}
+
+int main(int argc, char **argv){
+    i32 frames = 500;
+    i32 threads = job_cpu_count();
+    i32 divisor = 1;
+
+    for(i32 i = 1; i < argc; i++){
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc? argv[i + 1] : NULL;
+        if(!value || arg[0] != '-' || strlen(arg) != 2){
+            usage();
+            return 1;
+        }
+        switch(arg[1]){
+            case 'n': frames = atoi(value); break;
+            case 't': threads = atoi(value); break;
+            case 'd': divisor = atoi(value); break;
+            default: usage(); return 1;
+        }
+        i++;
+    }
+    frames = MAX(frames, 1);
+    threads = MAX(1, MIN(threads, JOB_MAX_WORKERS));
+    divisor = MAX(divisor, 1);
+    i32 width = WINDOW_W / divisor, height = WINDOW_H / divisor;
+
+    stbi_set_flip_vertically_on_load(true); // GL row order, like the game
+    i32 sheet_w, sheet_h;
+    u8 *sheet = stbi_load("data/tile_sprite.png", &sheet_w, &sheet_h, NULL, 4);
+    if(!sheet){
+        printf("Can't load data/tile_sprite.png, run from the repo root\n");
+        return 1;
+    }
+
+    static JobPool pool;
+    job_pool_init(&pool, threads);
+    static Raster single, tiled;
+    if(!raster_init(&single, width, height, NULL) || !raster_init(&tiled, width, height, &pool)){
+        printf("Out of memory\n");
+        return 1;
+    }
+    // the sheet goes in the atlas corner like atlas_add_bitmap puts it
+    u32 atlas = raster_create_texture(&single, NULL, ATLAS_SIZE, ATLAS_SIZE);
+    raster_update_texture(&single, atlas, 0, ATLAS_SIZE - sheet_h, sheet_w, sheet_h, sheet);
+    raster_create_texture(&tiled, NULL, ATLAS_SIZE, ATLAS_SIZE);
+    raster_update_texture(&tiled, atlas, 0, ATLAS_SIZE - sheet_h, sheet_w, sheet_h, sheet);
+    stbi_image_free(sheet);
+
+    static Vertex vertices[1024];
+    static SpriteInstance instances[4096];
+    static VertexRange ranges[64];
+    static RenderBatch batches[64];
+    BenchFrame f = {vertices, instances, ranges, batches};
+    Uniforms uniforms;
+    default_uniforms(&uniforms);
+    build_frame(&f, &uniforms, atlas);
+
+    raster_draw_frame(&single, &f.frame);
+    raster_draw_frame(&tiled, &f.frame);
+    if(memcmp(single.pixels, tiled.pixels, sizeof(u32) * width * height) != 0){
+        printf("tiled frame differs from the single thread one!\n");
+        return 1;
+    }
+
+    f64 t_single = run(&single, &f.frame, frames);
+    f64 t_tiled = run(&tiled, &f.frame, frames);
+    printf("%dx%d, %d sprites, %d vertices, %d batches, %d frames\n", width, height,
+        f.frame.instance_count, f.frame.vertex_count, f.frame.batch_count, frames);
+    printf("1 thread    %8.1f frames/sec  %6.3f ms\n", frames / t_single, t_single / frames * 1e3);
+    printf("%2d threads  %8.1f frames/sec  %6.3f ms  %5.2fx\n", threads, frames / t_tiled, t_tiled / frames * 1e3, t_single / t_tiled);
+
+    job_pool_shutdown(&pool);
+    raster_free(&single);
+    raster_free(&tiled);
+    return 0;
+}
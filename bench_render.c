@@ -0,0 +1,143 @@
+// Cpu cost of a game frame on the null render backend: what game_running
+// (simulation plus draw_scene and the overlays) and execute_draw_commands
+// (sort, batching, the backend copy) take, with no driver in the way.
+// Builds the real game code with headless.c, run it from the repo root.
+//
+//   bench_render [-n frames] [-r rows] [-b null|thread|copy] [-T trace.json]
+//
+// -r fills that many bottom rows of the board (with one hole each, so they
+// never clear) so draw_grid draws a busy board. -b thread runs the null
+// backend behind render_thread.c, submit is then the handoff of the frame
+// packet (and the wait for the frame before it). -b copy is the same with
+// reserve_streams hidden from the thread, so the streams are recorded into
+// the packet and copied, like GL without persistent mapping. -T writes the
+// profiler zones of the last frames as a Chrome trace.
+
+#include "engine.h"
+#include "game.h"
+#include "renderer.h"
+#include "profiler.h"
+
+#include <string.h>
+#include <time.h>
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+static void start_game(i32 rows){
+    restart_game(&Game, true);
+    Game.autoplay_used = true; // keeps update_game from saving a replay on game over
+    for(i32 y = GridH - rows; y < GridH; y++){
+        for(i32 x = 0; x < GridW; x++){
+            if(x != (y * 3) % GridW)
+                sim_set_cell(&Game.sim, x, y, 1 + (x + y) % PIECE_COUNT);
+        }
+    }
+}
+
+static void usage(void){
+    printf("usage: bench_render [-n frames] [-r rows] [-b null|thread|copy] [-T trace.json]\n");
+}
+
+int main(int argc, char **argv){
+    i32 frames = 5000;
+    i32 rows = 12;
+    const char *trace_path = NULL;
+    b32 threaded = false, copied = false;
+
+    for(i32 i = 1; i < argc; i++){
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc? argv[i + 1] : NULL;
+        if(!value || arg[0] != '-' || strlen(arg) != 2){
+            usage();
+            return 1;
+        }
+        switch(arg[1]){
+            case 'n': frames = atoi(value); break;
+            case 'r': rows = atoi(value); break;
+            case 'T': trace_path = value; break;
+            case 'b':
+                if(strcmp(value, "thread") == 0)    threaded = true;
+                else if(strcmp(value, "copy") == 0) threaded = copied = true;
+                else if(strcmp(value, "null") != 0){ usage(); return 1; }
+                break;
+            default: usage(); return 1;
+        }
+        i++;
+    }
+    frames = MAX(frames, 1);
+    rows = clampi(rows, 0, GridH - 4);
+
+    profiler_thread_name("main");
+    set_seed(0x5eed);
+    RenderBackend *null = null_backend_create();
+    if(copied) null->reserve_streams = NULL;
+    RenderBackend *backend = threaded? render_thread_create(null, NULL, NULL, NULL) : null;
+    engine_setup(backend);
+    GameMode = GM_Running;
+    TimeElapsed = 1.0f / 60.0f;
+    start_game(rows);
+
+    // Whole game frames
+    f64 running = 0, submit = 0;
+    for(i32 i = 0; i < frames; i++){
+        if(Game.sim.game_over) start_game(rows);
+        PROFILE_BEGIN("frame");
+        f64 t0 = wall_seconds();
+        game_running();
+        f64 t1 = wall_seconds();
+        execute_draw_commands();
+        reset_frame_stats();
+        f64 t2 = wall_seconds();
+        PROFILE_END();
+        running += t1 - t0;
+        submit  += t2 - t1;
+    }
+    if(threaded) render_thread_flush(backend);
+    RenderCounters game = *null_backend_counters(null);
+
+    // Only draw_scene, the same board every frame
+    f64 scene = 0, scene_submit = 0;
+    for(i32 i = 0; i < frames; i++){
+        PROFILE_BEGIN("frame");
+        f64 t0 = wall_seconds();
+        draw_scene(&Game);
+        f64 t1 = wall_seconds();
+        execute_draw_commands();
+        reset_frame_stats();
+        f64 t2 = wall_seconds();
+        PROFILE_END();
+        scene += t1 - t0;
+        scene_submit += t2 - t1;
+    }
+    if(threaded) render_thread_flush(backend);
+    const RenderCounters *total = null_backend_counters(null);
+
+    f64 n = (f64)frames;
+    printf("backend %s, %d frames, %d board rows\n", backend->name, frames, rows);
+    printf("                 record us  submit us  batches  changes  vertices  sprites  bytes\n");
+    printf("game_running   %10.2f %10.2f %8.1f %8.1f %9.1f %8.1f %6.0f\n",
+        running / n * 1e6, submit / n * 1e6, game.batches / n, game.state_changes / n,
+        game.vertices / n, game.instances / n, (game.vertex_bytes + game.instance_bytes) / n);
+    printf("draw_scene     %10.2f %10.2f %8.1f %8.1f %9.1f %8.1f %6.0f\n",
+        scene / n * 1e6, scene_submit / n * 1e6, (total->batches - game.batches) / n,
+        (total->state_changes - game.state_changes) / n, (total->vertices - game.vertices) / n,
+        (total->instances - game.instances) / n,
+        (total->vertex_bytes + total->instance_bytes - game.vertex_bytes - game.instance_bytes) / n);
+    printf("textures: %llu created, %llu updates, %llu bytes, %llu stream grows\n",
+        (unsigned long long)total->texture_creates, (unsigned long long)total->texture_updates,
+        (unsigned long long)total->texture_bytes, (unsigned long long)total->grows);
+
+    if(threaded) render_thread_destroy(backend);
+    if(trace_path){
+        if(!profiler_dump_trace(trace_path)){
+            printf("Can't write %s\n", trace_path);
+            return 1;
+        }
+        printf("trace written to %s\n", trace_path);
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Plays whole games headless as fast as possible and reports throughput
+// and line clear statistics. Only uses libsim, build with build_linux.sh.
+//
+//   bench_sim [-g games] [-t threads] [-p random|greedy] [-m max_pieces] [-s seed]
+
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+#include "jobs.h"
+#include "bot.h"
+
+#include <string.h>
+#include <time.h>
+
+enum BenchPolicy{
+    POLICY_RANDOM,
+    POLICY_GREEDY,
+};
+
+typedef struct{
+    i32 games;
+    i64 pieces;
+    i64 ticks;
+    i64 score;
+    i64 clears[5]; // by lines removed at once
+    i32 capped;    // games stopped by max_pieces
+}BenchStats;
+
+typedef struct{
+    i32 policy;
+    i32 games;
+    i32 max_pieces;
+    u64 rng; // stream for this job only
+    PlacementSearch search;
+    BenchStats stats;
+}BenchJob;
+
+static u64 bench_random(u64 *rng){
+    *rng += 0x9e3779b97f4a7c15;
+    u64 z = *rng;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+static i32 choose_placement(BenchJob *job, const SimState *state, i32 count){
+    if(job->policy == POLICY_RANDOM)
+        return (i32)(bench_random(&job->rng) % (u64)count);
+
+    i32 best = 0;
+    f32 best_score = 0;
+    for(i32 i = 0; i < count; i++){
+        const Placement *p = &job->search.placements[i];
+        Board board = state->grid;
+        u32 full = board_set_piece(&board, p->x, p->y, p->piece);
+        board_remove_rows(&board, full);
+        i32 lines = popcount32(full);
+        f32 score = bot_evaluate(&BotDefaultWeights, &board, lines);
+        if(i == 0 || score > best_score){
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// The piece is moved to its lock position right away and down is held
+// until it locks, everything else goes through sim_step as in the game
+static void play_game(BenchJob *job){
+    SimState state;
+    sim_init(&state, bench_random(&job->rng) | 1);
+    BenchStats *stats = &job->stats;
+
+    i32 moved = 0;
+    u8 path[PLACEMENT_STATES];
+    while(!state.game_over){
+        if(state.piece_count != moved && !state.aim.piece_setted){
+            moved = state.piece_count;
+            if(job->max_pieces && state.piece_count > job->max_pieces){
+                stats->capped++;
+                break;
+            }
+            i32 count = find_placements(&job->search, &state.grid, state.aim.piece, state.aim.x, state.aim.y);
+            if(count){
+                const Placement *p = &job->search.placements[choose_placement(job, &state, count)];
+                i32 length = placement_path(&job->search, p, path, array_size(path));
+                sim_apply_moves(&state, path, length);
+            }
+        }
+
+        i32 score = state.score;
+        sim_step(&state, SIM_INPUT_DOWN, 1);
+        stats->ticks++;
+        i32 lines = (state.score - score) / SIM_LINE_SCORE;
+        if(lines > 0) stats->clears[MIN(lines, 4)]++;
+    }
+
+    stats->games++;
+    stats->pieces += state.piece_count;
+    stats->score += state.score;
+}
+
+static void bench_job(JobPool *pool, i32 worker, void *data){
+    (void)pool; (void)worker;
+    BenchJob *job = data;
+    for(i32 i = 0; i < job->games; i++)
+        play_game(job);
+}
+
+static void usage(void){
+    printf("usage: bench_sim [-g games] [-t threads] [-p random|greedy] [-m max_pieces] [-s seed]\n");
+}
+
+int main(int argc, char **argv){
+    i32 games = 1000;
+    i32 threads = job_cpu_count();
+    i32 policy = POLICY_RANDOM;
+    i32 max_pieces = 10000;
+    u64 seed = 1;
+
+    for(i32 i = 1; i < argc; i++){
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc? argv[i + 1] : NULL;
+        if(!value || arg[0] != '-' || strlen(arg) != 2){
+            usage();
+            return 1;
+        }
+        switch(arg[1]){
+            case 'g': games = atoi(value); break;
+            case 't': threads = atoi(value); break;
+            case 'm': max_pieces = atoi(value); break;
+            case 's': seed = strtoull(value, NULL, 0); break;
+            case 'p':
+                if(strcmp(value, "random") == 0)      policy = POLICY_RANDOM;
+                else if(strcmp(value, "greedy") == 0) policy = POLICY_GREEDY;
+                else { usage(); return 1; }
+                break;
+            default: usage(); return 1;
+        }
+        i++;
+    }
+    threads = MAX(1, MIN(threads, JOB_MAX_WORKERS));
+    games = MAX(games, 1);
+
+    static JobPool pool;
+    static BenchJob jobs[JOB_MAX_WORKERS];
+    job_pool_init(&pool, threads);
+
+    // every job gets its own seed stream, so results only depend on
+    // the seed and the thread count
+    u64 stream = seed;
+    for(i32 i = 0; i < threads; i++){
+        jobs[i].policy = policy;
+        jobs[i].games = games / threads + (i < games % threads);
+        jobs[i].max_pieces = max_pieces;
+        jobs[i].rng = bench_random(&stream);
+    }
+
+    f64 start = wall_seconds();
+    for(i32 i = 0; i < threads; i++)
+        job_push(&pool, 0, bench_job, &jobs[i]);
+    job_pool_wait(&pool, 0);
+    f64 seconds = wall_seconds() - start;
+    job_pool_shutdown(&pool);
+
+    BenchStats total = {0};
+    for(i32 i = 0; i < threads; i++){
+        BenchStats *s = &jobs[i].stats;
+        total.games  += s->games;
+        total.pieces += s->pieces;
+        total.ticks  += s->ticks;
+        total.score  += s->score;
+        total.capped += s->capped;
+        for(i32 j = 0; j < array_size(s->clears); j++) total.clears[j] += s->clears[j];
+    }
+
+    printf("policy %s, %d games on %d threads in %.3fs\n", policy == POLICY_RANDOM? "random" : "greedy", total.games, threads, seconds);
+    printf("games/sec  %.1f\n", total.games / seconds);
+    printf("pieces/sec %.1f\n", total.pieces / seconds);
+    printf("ticks/sec  %.1f\n", total.ticks / seconds);
+    printf("pieces/game %.1f, score/game %.1f, capped at %d pieces: %d\n",
+        (f64)total.pieces / total.games, (f64)total.score / total.games, max_pieces, total.capped);
+
+    i64 clears = total.clears[1] + total.clears[2] + total.clears[3] + total.clears[4];
+    printf("line clears %lld\n", (long long)clears);
+    for(i32 i = 1; i < array_size(total.clears); i++)
+        printf("  %d line%s %10lld  %5.1f%%\n", i, i > 1? "s" : " ", (long long)total.clears[i], clears? 100.0 * total.clears[i] / clears : 0.0);
+    return 0;
+}
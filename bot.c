@@ -0,0 +1,104 @@
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+#include "jobs.h"
+#include "bot.h"
+
+// Weights from the usual four feature tetris evaluator
+const BotWeights BotDefaultWeights = {
+    .height    = -0.510066f,
+    .lines     =  0.760666f,
+    .holes     = -0.356630f,
+    .bumpiness = -0.184483f,
+};
+
+#define BOT_LOSS_SCORE -1e30f
+
+// Column features come straight from the board counters, see board_column_height
+f32 bot_evaluate(const BotWeights *weights, const Board *board, i32 lines){
+    i32 height = 0;
+    i32 holes = 0;
+    i32 bumpiness = 0;
+
+    for(i32 x = 0; x < GridW; x++){
+        i32 column_height = board_column_height(board, x);
+        height += column_height;
+        holes  += board_column_holes(board, x);
+        if(x) bumpiness += abs(column_height - board_column_height(board, x - 1));
+    }
+
+    return weights->height * height + weights->lines * lines + weights->holes * holes + weights->bumpiness * bumpiness;
+}
+
+static void think_job(JobPool *pool, i32 worker, void *data){
+    (void)pool;
+    struct BotJob *job = data;
+    Bot *bot = job->bot;
+    i32 index = job->index;
+    const Placement *first = &bot->root.placements[index];
+
+    Board board = *bot->board;
+    u32 full = board_set_piece(&board, first->x, first->y, first->piece);
+    board_remove_rows(&board, full);
+    i32 lines = popcount32(full);
+
+    // the next piece can't even spawn, only take this if nothing else is left
+    PlacementSearch *search = &bot->scratch[worker];
+    i32 count = find_placements(search, &board, bot->next_piece, bot->next_x, bot->next_y);
+    if(!count){
+        bot->scores[index] = BOT_LOSS_SCORE;
+        return;
+    }
+
+    f32 best = BOT_LOSS_SCORE;
+    for(i32 i = 0; i < count; i++){
+        const Placement *second = &search->placements[i];
+        Board next = board;
+        u32 next_full = board_set_piece(&next, second->x, second->y, second->piece);
+        board_remove_rows(&next, next_full);
+        i32 next_lines = popcount32(next_full);
+        f32 score = bot_evaluate(&bot->weights, &next, lines + next_lines);
+        best = MAX(best, score);
+    }
+    bot->scores[index] = best;
+}
+
+void bot_init(Bot *bot, i32 worker_count){
+    bot->weights = BotDefaultWeights;
+    job_pool_init(&bot->pool, worker_count);
+}
+
+void bot_shutdown(Bot *bot){
+    job_pool_shutdown(&bot->pool);
+}
+
+BotDecision bot_think(Bot *bot, const SimState *state){
+    BotDecision decision = {0};
+    if(state->game_over || state->aim.piece_setted) return decision;
+
+    bot->board = &state->grid;
+    bot->next_piece = state->aim.next_piece;
+    bot->next_x = piece_spawn_x(state->aim.next_piece);
+    bot->next_y = 0;
+
+    i32 count = find_placements(&bot->root, &state->grid, state->aim.piece, state->aim.x, state->aim.y);
+    for(i32 i = 0; i < count; i++){
+        bot->jobs[i] = (struct BotJob){.bot = bot, .index = i};
+        job_push(&bot->pool, 0, think_job, &bot->jobs[i]);
+    }
+    job_pool_wait(&bot->pool, 0);
+
+    for(i32 i = 0; i < count; i++){
+        if(!decision.found || bot->scores[i] > decision.score){
+            decision.found = true;
+            decision.score = bot->scores[i];
+            decision.placement = bot->root.placements[i];
+        }
+    }
+
+    if(decision.found){
+        decision.path_count = placement_path(&bot->root, &decision.placement, decision.path, BOT_PATH_MAX);
+        if(decision.path_count > BOT_PATH_MAX) decision.found = false;
+    }
+    return decision;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Autoplay. Every lock position of the current piece is tried, then every
+// lock position of the next piece on the board it leaves, and the pair
+// with the best board score wins. Each first level placement is one job
+// in the pool so the two ply search uses every core.
+
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+#include "jobs.h"
+
+#define BOT_PATH_MAX 64
+
+typedef struct{
+    f32 height;
+    f32 lines;
+    f32 holes;
+    f32 bumpiness;
+}BotWeights;
+
+typedef struct{
+    b32 found;
+    f32 score;
+    Placement placement;
+    i32 path_count;
+    u8 path[BOT_PATH_MAX]; // SIM_INPUT_* moves, one per entry, see sim_apply_moves
+}BotDecision;
+
+typedef struct Bot{
+    BotWeights weights;
+    JobPool pool;
+
+    // filled by bot_think before the jobs start, read only while they run
+    const Board *board;
+    Piece next_piece;
+    i32 next_x, next_y;
+
+    PlacementSearch root;
+    f32 scores[PLACEMENT_MAX];
+    struct BotJob{
+        struct Bot *bot;
+        i32 index; // into root.placements
+    }jobs[PLACEMENT_MAX];
+    PlacementSearch scratch[JOB_MAX_WORKERS]; // one per worker, never shared
+}Bot;
+
+extern const BotWeights BotDefaultWeights;
+
+void bot_init(Bot *bot, i32 worker_count);
+void bot_shutdown(Bot *bot);
+f32 bot_evaluate(const BotWeights *weights, const Board *board, i32 lines);
+BotDecision bot_think(Bot *bot, const SimState *state);
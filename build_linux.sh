@@ -0,0 +1,60 @@
+#!/bin/sh
+# Headless targets only, the game itself is built with build_msvc.bat
+
+command -v cc >/dev/null || {
+  echo "ERROR: \"cc\" not found - please install gcc or clang."
+  exit 1
+}
+
+compiler=cc
+sim_files="simulation.c replay.c placement.c jobs.c bot.c battle.c profiler.c"
+warnings="-Werror -Wall -Wextra -Wno-missing-braces -Wno-missing-field-initializers"
+debug_warnings="-Wno-unused-variable -Wno-unused-but-set-variable"
+debugger="-g -fsanitize=address"
+out=build
+
+case "$1" in
+  debug)
+    echo "-DEBUG build-"
+    flags="-std=gnu11 $debugger $warnings $debug_warnings -DDEBUG_BUILD"
+    ;;
+  release)
+    echo "-RELEASE build-"
+    flags="-std=gnu11 -O2 $warnings"
+    ;;
+  *)
+    echo "No build configuration! Use \"debug\" or \"release\""
+    exit 1
+    ;;
+esac
+
+mkdir -p $out || exit 1
+
+# libsim.a: game rules without renderer, audio or OS layer
+objects=""
+for file in $sim_files; do
+  object="$out/${file%.c}.o"
+  $compiler $flags -c $file -o $object || exit 1
+  objects="$objects $object"
+done
+ar rcs $out/libsim.a $objects || exit 1
+
+# bench_sim: plays whole games headless, see the top of bench_sim.c
+$compiler $flags bench_sim.c $out/libsim.a -lpthread -o $out/bench_sim || exit 1
+
+# bench_lines: line clear detection and compaction micro benchmark
+$compiler $flags bench_lines.c $out/libsim.a -o $out/bench_lines || exit 1
+
+# battle_server: thousands of paired boards per tick, see the top of battle_server.c
+$compiler $flags battle_server.c $out/libsim.a -lpthread -o $out/battle_server || exit 1
+
+# bench_raster: software rasterizer frames per second, see the top of bench_raster.c
+$compiler $flags -Idependencies/stb-lib bench_raster.c raster.c $out/libsim.a -lpthread -lm -o $out/bench_raster || exit 1
+
+# bench_render: cpu cost of game frames on the null render backend, see the top of bench_render.c
+game_files="game.c menu.c fonts.c renderer.c renderer_null.c render_thread.c engine.c headless.c"
+freetype=$(pkg-config --cflags --libs freetype2 2>/dev/null || echo "-I/usr/include/freetype2 -lfreetype")
+$compiler $flags -Idependencies/stb-lib bench_render.c $game_files $out/libsim.a $freetype -lpthread -lm -o $out/bench_render || exit 1
+
+# golden_frames: renders game frames with raster.c and checks them against data/golden, see the top of golden_frames.c
+$compiler $flags -Idependencies/stb-lib golden_frames.c $game_files raster.c renderer_raster.c png_writer.c $out/libsim.a $freetype -lpthread -lm -o $out/golden_frames || exit 1
@@ -11,7 +11,7 @@ if not exist freetype.dll (
 
 set name=program.exe
 set compiler=cl
-set files=game.c windows.c fonts.c renderer.c engine.c menu.c
+set files=game.c simulation.c replay.c placement.c jobs.c bot.c profiler.c file_watch.c windows.c fonts.c renderer.c renderer_gl.c render_thread.c engine.c menu.c
 set libs=User32.lib Gdi32.lib Winmm.lib
 set warnings=/WX /W4 /w44255 /wd4996 /wd4201 /wd4152
 set debug_warnings=/wd4189 /wd4101
@@ -1,8 +1,10 @@
 #define BASIC_IMPLEMENT
 #define UTIL_IMPLEMENT
 
+#if defined(_MSC_VER)
 #pragma comment(lib, "dependencies\\freetype-lib\\x64\\freetype.lib")
 #pragma comment(lib, "opengl32.lib")
+#endif
 
 #include "basic.h"
 #include "engine.h"
@@ -38,9 +40,9 @@ static f32 repeat_delay  = 0.25f;
 static f32 pressed_timer = 0;
 static i32 key_to_repeat = KEYCODE_NONE;
 
-void engine_setup(void){
+void engine_setup(struct RenderBackend *backend){
     GameRunning = true;
-    engine_init();
+    engine_init(backend);
 }
 
 void engine_clear_input(void){
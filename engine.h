@@ -106,11 +106,13 @@ static inline b32 button_pressed(u32 key_code){ // @Move
 
 extern b32 GameRunning;
 
-void engine_init(void);
+// The platform layer picks the render backend, see render_backend.h
+struct RenderBackend;
+void engine_init(struct RenderBackend *backend);
 void engine_update(void);
 void engine_clear_input(void);
 void engine_process_input(void);
-void engine_setup(void);
+void engine_setup(struct RenderBackend *backend);
 
 typedef struct {
 	i16* samples;
@@ -136,16 +138,13 @@ typedef struct{
 }Date;
 
 // OS functions
-b32 update_file_info(void *info_handle);
-void *get_file_handle(void *file_info); // @debug
-void *create_file_info(void *file); // @debug
 void *os_open_file(const char *name);
 b32 os_close_file(void *file);
 u8* os_read_whole_file(const char *name, i32 *bytes);
 u8* os_read_whole_file_handle(void *file_handle, i32 *size);
 b32 os_write_to_file(void *data, i32 bytes, const char *name);
 b32 os_read_file(void *buffer, i32 bytes, const char *name);
-char* os_font_path(char *buffer, u32 size, const char *append);
+char* os_font_path(char *buffer, u32 size, const char *font_name); // full path of a system font
 Date os_get_local_time(void);
 void *os_memory_alloc(size_t bytes);
 b32 os_memory_free(void *address);
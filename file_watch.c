@@ -0,0 +1,163 @@
+#include "basic.h"
+#include "file_watch.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+static inline i32 atomic_load(volatile i32 *value){
+    return InterlockedCompareExchange((volatile LONG *)value, 0, 0);
+}
+static inline void atomic_store(volatile i32 *value, i32 desired){
+    InterlockedExchange((volatile LONG *)value, desired);
+}
+static inline void sleep_ms(i32 ms){ Sleep(ms); }
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+static inline i32 atomic_load(volatile i32 *value){
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+static inline void atomic_store(volatile i32 *value, i32 desired){
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+static inline void sleep_ms(i32 ms){ usleep(ms * 1000); }
+#endif
+
+// Called from the watcher thread only. A full queue makes the thread wait,
+// an edit is never dropped. The same file twice in a row is queued once.
+static void post_change(FileWatch *watch, const char *name, i32 length){
+    if(length <= 0 || length >= FILE_WATCH_NAME_SIZE) return;
+
+    i32 head = watch->head;
+    if(head != atomic_load(&watch->tail)){
+        const char *last = watch->names[(head - 1) & (FILE_WATCH_QUEUE_SIZE - 1)];
+        if(strncmp(last, name, length) == 0 && last[length] == '\0') return;
+    }
+
+    while(head - atomic_load(&watch->tail) >= FILE_WATCH_QUEUE_SIZE){
+        if(!atomic_load(&watch->running)) return;
+        sleep_ms(10);
+    }
+
+    char *slot = watch->names[head & (FILE_WATCH_QUEUE_SIZE - 1)];
+    memcpy(slot, name, length);
+    slot[length] = '\0';
+    atomic_store(&watch->head, head + 1);
+}
+
+b32 file_watch_next(FileWatch *watch, char *name, i32 size){
+    i32 tail = watch->tail;
+    if(tail == atomic_load(&watch->head)) return false;
+
+    const char *slot = watch->names[tail & (FILE_WATCH_QUEUE_SIZE - 1)];
+    i32 length = MIN((i32)strlen(slot), size - 1);
+    memcpy(name, slot, length);
+    name[length] = '\0';
+    atomic_store(&watch->tail, tail + 1);
+    return true;
+}
+
+#if defined(_WIN32)
+
+static DWORD WINAPI watch_thread(LPVOID param){
+    FileWatch *watch = param;
+    DWORD buffer[1024]; // FILE_NOTIFY_INFORMATION wants DWORD alignment
+    char name[FILE_WATCH_NAME_SIZE];
+
+    while(atomic_load(&watch->running)){
+        DWORD bytes = 0;
+        DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+        // Blocks until something changes, file_watch_stop cancels it
+        if(!ReadDirectoryChangesW(watch->handle, buffer, sizeof(buffer), FALSE, filter, &bytes, NULL, NULL))
+            break;
+        if(!bytes) continue; // overflowed, nothing to report by name
+
+        u8 *at = (u8 *)buffer;
+        for(;;){
+            FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)at;
+            if(info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME){
+                i32 length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                    name, sizeof(name) - 1, NULL, NULL);
+                post_change(watch, name, length);
+            }
+            if(!info->NextEntryOffset) break;
+            at += info->NextEntryOffset;
+        }
+    }
+    return 0;
+}
+
+b32 file_watch_start(FileWatch *watch, const char *directory){
+    set_zero(watch, sizeof(*watch));
+    watch->handle = CreateFileA(directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if(watch->handle == INVALID_HANDLE_VALUE) return false;
+
+    watch->running = true;
+    watch->thread = CreateThread(NULL, 0, watch_thread, watch, 0, NULL);
+    if(!watch->thread){
+        CloseHandle(watch->handle);
+        return false;
+    }
+    return true;
+}
+
+void file_watch_stop(FileWatch *watch){
+    atomic_store(&watch->running, false);
+    // the thread may not be inside ReadDirectoryChangesW yet, keep cancelling
+    while(WaitForSingleObject(watch->thread, 10) == WAIT_TIMEOUT)
+        CancelSynchronousIo(watch->thread);
+    CloseHandle(watch->thread);
+    CloseHandle(watch->handle);
+}
+
+#else
+
+static void *watch_thread(void *param){
+    FileWatch *watch = param;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while(atomic_load(&watch->running)){
+        // Wakes up now and then to see if file_watch_stop was called
+        struct pollfd fd = {.fd = watch->handle, .events = POLLIN};
+        if(poll(&fd, 1, 100) <= 0) continue;
+
+        ssize_t bytes = read(watch->handle, buffer, sizeof(buffer));
+        for(ssize_t at = 0; at < bytes;){
+            const struct inotify_event *event = (const struct inotify_event *)(buffer + at);
+            if(event->len) post_change(watch, event->name, (i32)strlen(event->name));
+            at += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return NULL;
+}
+
+b32 file_watch_start(FileWatch *watch, const char *directory){
+    set_zero(watch, sizeof(*watch));
+    watch->handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watch->handle < 0) return false;
+    // close after write and moved in, editors that save through a rename too
+    if(inotify_add_watch(watch->handle, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+        close(watch->handle);
+        return false;
+    }
+
+    watch->running = true;
+    if(pthread_create(&watch->thread, NULL, watch_thread, watch) != 0){
+        close(watch->handle);
+        return false;
+    }
+    return true;
+}
+
+void file_watch_stop(FileWatch *watch){
+    atomic_store(&watch->running, false);
+    pthread_join(watch->thread, NULL);
+    close(watch->handle);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+// Watches one directory from a background thread (inotify on Linux,
+// ReadDirectoryChangesW on Windows) and queues the names of the files
+// written in it. The owner drains the queue when it wants to, which is a
+// single atomic load when nothing changed.
+
+#include "basic.h"
+
+#if defined(_WIN32)
+typedef void *FileWatchThread;
+typedef void *FileWatchHandle; // the directory
+#else
+#include <pthread.h>
+typedef pthread_t FileWatchThread;
+typedef i32 FileWatchHandle;   // inotify instance
+#endif
+
+#define FILE_WATCH_QUEUE_SIZE 32 // power of two
+#define FILE_WATCH_NAME_SIZE  64
+
+typedef struct{
+    FileWatchHandle handle;
+    FileWatchThread thread;
+    volatile i32 running;
+
+    // single producer (the thread), single consumer (the owner)
+    volatile i32 head;
+    volatile i32 tail;
+    char names[FILE_WATCH_QUEUE_SIZE][FILE_WATCH_NAME_SIZE];
+}FileWatch;
+
+b32 file_watch_start(FileWatch *watch, const char *directory);
+void file_watch_stop(FileWatch *watch);
+b32 file_watch_next(FileWatch *watch, char *name, i32 size); // false when no changes are left
@@ -2,6 +2,7 @@
 #include "game.h"
 #include "basic.h"
 #include "renderer.h"
+#include "profiler.h"
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -20,23 +21,21 @@ typedef struct{
 
 Font *CurrentFont = NULL;
 
-GlyphInfo append_glyph_on_atlas(GlyphAtlasContext *atlas, u32 char_index, FT_Face face){
+// Returns false when the glyph doesn't fit, large font sizes run out
+b32 append_glyph_on_atlas(GlyphInfo *g, GlyphAtlasContext *atlas, u32 char_index, FT_Face face){
     u32 ft_error = FT_Load_Glyph(face, char_index, FT_LOAD_RENDER);
     assert(!ft_error);
 
     FT_Bitmap bitmap = face->glyph->bitmap;
 
     if(bitmap.width >= atlas->row_width_left){
-        assert(atlas->height_left > atlas->row_break);
+        if(bitmap.width >= atlas->width || atlas->height_left <= atlas->row_break) return false;
         atlas->height_left -= atlas->row_break;
         atlas->row_break = 0;
         atlas->row_width_left = atlas->width;
     }
 
-    if(bitmap.rows >= atlas->height_left){
-        printf("not enough space in font atlas!\n");
-        assert(false);
-    }
+    if(bitmap.rows >= atlas->height_left) return false;
 
     for(u32 y = 0; y < bitmap.rows; y++){
         for(u32 x = 0; x < bitmap.width; x++){
@@ -46,27 +45,28 @@ GlyphInfo append_glyph_on_atlas(GlyphAtlasContext *atlas, u32 char_index, FT_Fac
         }
     }
 
-    GlyphInfo g;
-    g.w = bitmap.width;
-    g.h = bitmap.rows;
-    g.offset.x = face->glyph->bitmap_left;
-    g.offset.y = face->glyph->bitmap_top;
-    g.atlas.x  = atlas->width - atlas->row_width_left;
-    g.atlas.y  = atlas->height - atlas->height_left;
-    g.advance  = face->glyph->advance.x / 64;
+    g->w = bitmap.width;
+    g->h = bitmap.rows;
+    g->offset.x = face->glyph->bitmap_left;
+    g->offset.y = face->glyph->bitmap_top;
+    g->atlas.x  = atlas->width - atlas->row_width_left;
+    g->atlas.y  = atlas->height - atlas->height_left;
+    g->advance  = face->glyph->advance.x / 64;
 
     atlas->row_break = MAX(atlas->row_break, bitmap.rows);
     atlas->row_width_left -= bitmap.width;
 
-    return g;
+    return true;
 }
 
-Font load_font(const char *name, i32 height_pixel_size){
+// Returns false if the font file can't be opened or its glyphs don't fit
+b32 load_font(Font *font, const char *name, i32 height_pixel_size){
     FT_Face face;
     u32 ft_error;
 
     ft_error = FT_New_Face(Lib, name, 0, &face);
-    assert(!ft_error);
+    if(ft_error) return false;
+    PROFILE_BEGIN("load_font");
 
     ft_error = FT_Select_Charmap(face, FT_ENCODING_UNICODE);
     assert(!ft_error);
@@ -88,27 +88,33 @@ Font load_font(const char *name, i32 height_pixel_size){
     }
 
     FT_Set_Pixel_Sizes(face, 0, height_pixel_size);
-    Font font;
 
     // load null char
     u32 char_index = FT_Get_Char_Index(face, 0);
-    font.glyphs[0] = append_glyph_on_atlas(&atlas, char_index, face);
+    b32 result = append_glyph_on_atlas(&font->glyphs[0], &atlas, char_index, face);
 
-    for(i32 c = 1; c < ASCII_TABLE_SIZE; c++){ // loading all ascii characters
+    for(i32 c = 1; result && c < ASCII_TABLE_SIZE; c++){ // loading all ascii characters
         char_index = FT_Get_Char_Index(face, c);
-        font.glyphs[c] = char_index
-            ? append_glyph_on_atlas(&atlas, char_index, face)
-            : font.glyphs[0];
+        if(char_index) result = append_glyph_on_atlas(&font->glyphs[c], &atlas, char_index, face);
+        else font->glyphs[c] = font->glyphs[0];
     }
 
-    font.atlas.id = create_texture_from_bitmap((u8*)atlas.buffer, atlas.width, atlas.height);
-    font.line_height  = height_pixel_size;
-    font.atlas.width  = atlas.width;
-    font.atlas.height = atlas.height;
+    // glyph rects are relative to the font's block in the shared atlas
+    Sprite block;
+    result = result && atlas_add_bitmap(&block, (u8*)atlas.buffer, atlas.width, atlas.height);
+    if(result){
+        for(i32 c = 0; c < ASCII_TABLE_SIZE; c++){
+            font->glyphs[c].atlas.x += block.x;
+            font->glyphs[c].atlas.y += block.y;
+        }
+        font->atlas = block.atlas;
+        font->line_height = height_pixel_size;
+    }
 
     os_memory_free(atlas.buffer);
     FT_Done_Face(face);
-    return font;
+    PROFILE_END();
+    return result;
 }
 
 void set_font(Font *font){
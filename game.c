@@ -2,29 +2,30 @@
 #include "basic.h"
 #include "game.h"
 #include "renderer.h"
+#include "bot.h"
+#include "profiler.h"
 
 #include <stdarg.h>
 #include <string.h>
 
-#define GridW 10
-#define GridH 20
-
 Font BigFont;
 Font DefaultFont;
 Font DebugFont; // @Debug
 
 GameControls Controls;
 
-i32 StreakOn = false;
-f32 StreakTimer = 0;
-i32 Grid[GridH][GridW] = {0};
-i32 PieceStatistics[array_size(Pieces)] = {0};
+GameInstance Game;
+
+#define REPLAY_RUN_CAPACITY (1 << 20)
+static u16 RecordingRuns[REPLAY_RUN_CAPACITY];
+
+// Shared by every instance, it only thinks for one of them at a time
+static Bot AutoBot;
+static b32 AutoBotReady = false;
 Scoreboard HighScore;
 
 const char *HighScoreFileName = "highscore.dat";
 
-const i32 BlinkTile = 200;
-
 static b32 confirmation_prompt_open = false;
 static i32 confirmation_prompt_cursor = 0;
 
@@ -41,81 +42,8 @@ Sound GameOverSound;
 Sound ScoreSound;
 Sound TetrisSound;
 
-// Using Super Rotation System
-
-const Piece Line = {
-    .side = 4,
-    .type = 1,
-    .bitmap = {
-        0, 0, 0, 0,
-        1, 1, 1, 1,
-        0, 0, 0, 0,
-        0, 0, 0, 0,
-    },
-};
-
-const Piece Block = {
-    .side = 2,
-    .type = 2,
-    .bitmap = {
-        1, 1,
-        1, 1,
-    },
-};
-
-const Piece Piramid = {
-    .side = 3,
-    .type = 3,
-    .bitmap = {
-        0, 1, 0,
-        1, 1, 1,
-        0, 0, 0,
-    },
-};
-
-const Piece LeftL = {
-    .side = 3,
-    .type = 4,
-    .bitmap = {
-        1, 0, 0,
-        1, 1, 1,
-        0, 0, 0,
-    },
-};
-
-const Piece RightL = {
-    .side = 3,
-    .type = 5,
-    .bitmap = {
-        0, 0, 1,
-        1, 1, 1,
-        0, 0, 0,
-    },
-};
-
-const Piece LeftZ = {
-    .side = 3,
-    .type = 6,
-    .bitmap = {
-        1, 1, 0,
-        0, 1, 1,
-        0, 0, 0,
-    },
-};
-
-const Piece RightZ = {
-    .side = 3,
-    .type = 7,
-    .bitmap = {
-        0, 1, 1,
-        1, 1, 0,
-        0, 0, 0,
-    },
-};
-
 const f32 BlockSize = 25.0f;
 
-const Piece *Pieces[7] = {&Line, &Block, &Piramid, &LeftL, &RightL, &LeftZ, &RightZ};
 const Vec4 PieceColors[] = {
     {1.0f, 1.0f, 1.0f, 1.0f},
     {0.0f, 0.0f, 1.0f, 1.0f},
@@ -127,19 +55,6 @@ const Vec4 PieceColors[] = {
     {0.2f, 0.3f, 0.1f, 1.0f},
 };
 
-i32 Score = 0;
-b32 GameOver = false;
-b32 GamePause = false;
-f32 GravityCount = 0;
-f32 MoveDownTime = 0.65f;
-
-struct{
-    b32 piece_setted;
-    i32 x, y;
-    Piece piece;
-    Piece next_piece;
-}Aim;
-
 enum DebugMode{
     none,
     place_aim,
@@ -184,7 +99,9 @@ void update_messages(void){
     for(i32 i = log->start; i != log->end; i = (i + 1) % array_size(log->messages)){
         DebugMessage *m = &log->messages[i];
         f32 width = (f32)count_text_width(m->content) + border * 2;
+        set_layer(LAYER_DEBUG);
         draw_rect(x, y, width, spacing, bg_color);
+        set_layer(LAYER_DEBUG_TEXT);
         draw_text(x + border, y, m->color, m->content);
         y -= spacing;
     }
@@ -205,136 +122,42 @@ void debug_message(Vec4 color, const char *format, ...){
 
     struct DebugMessageQueue_S *log = &DebugMessageQueue;
     DebugMessage *m = &log->messages[log->end];
-    log->end = ++log->end % array_size(log->messages);
-    if(log->start == log->end) log->start = ++log->start % array_size(log->messages);
+    log->end = (log->end + 1) % array_size(log->messages);
+    if(log->start == log->end) log->start = (log->start + 1) % array_size(log->messages);
     log->time = 0; // reset time
     strcpy(m->content, message);
     m->color = color;
 }
 
-void rotate_piece(Piece *piece, i32 dir){
-    Piece original = *piece;
-    for(i32 y = 0; y < piece->side; y++){
-        for(i32 x = 0; x < piece->side; x++){
-            if(dir < 0)
-                piece->bitmap[y * piece->side + x] = original.bitmap[x * original.side + original.side - 1 - y];
-            else
-                piece->bitmap[y * piece->side + (piece->side - 1 - x)] = original.bitmap[x * original.side + y];
-        }
-    }
-}
-
 static inline Vec4 get_piece_color(i32 piece_type){
-    assert(piece_type <= array_size(Pieces));
+    assert(piece_type <= PIECE_COUNT);
     return PieceColors[piece_type - 1];
 }
 
-b32 piece_collided(i32 x, i32 y, const Piece *piece);
-
-Piece random_piece(void){
-    static i32 history[4] = {-1, -1, -1, -1};
-    static i32 index = 0;
-    i32 roll = 0;
-
-    for(i32 j = 0; j < array_size(history); j++){
-        roll = random_n(array_size(Pieces));
-        b32 is_new = true;
-        for(i32 i = 0; i < array_size(history); i++){
-            if(roll == history[i]){
-                is_new = false;
-                break;
-            }
-        }
-        if(is_new) break;
-    }
-
-    history[index++] = roll;
-    index %= array_size(history);
-
-    return *Pieces[roll];
-}
-
-void spawn_next_piece(void){
-    Aim.piece = Aim.next_piece;
-    Aim.next_piece = random_piece();
-    Aim.piece_setted = false;
-    PieceStatistics[Aim.piece.type - 1]++;
-
-    Aim.x = (GridW - Aim.piece.side) / 2;
-    Aim.y = 0;
-}
-
-b32 try_spawn_next_piece(void){
-    spawn_next_piece();
-    return !piece_collided(Aim.x, Aim.y, &Aim.piece);
-}
-
-void set_piece(i32 x, i32 y, const Piece *p){
-    for(i32 i = 0; i < p->side; i++){
-        for(i32 j = 0; j < p->side; j++){
-            if(p->bitmap[i * p->side + j]){
-                i32 p_x = x + j;
-                i32 p_y = y + i;
-                if(p_x >= GridW || p_y >= GridH || p_x < 0 || p_y < 0) continue;
-                Grid[p_y][p_x] = p->type;
-            }
-        }
-    }
-}
-
 void draw_tile(i32 x, i32 y, Vec4 color, Sprite sprite){
     draw_sprite((f32)x * BlockSize, (f32)y * BlockSize, 1.0f, color, sprite);
 }
 
-void draw_piece(i32 p_x, i32 p_y, const Piece *piece){
-    for(i32 y = 0; y < piece->side; y++){
-        for(i32 x = 0; x < piece->side; x++){
-            if(piece->bitmap[y * piece->side + x]){
-                Vec4 color = get_piece_color(piece->type);
+void draw_piece(i32 p_x, i32 p_y, Piece piece){
+    Vec4 color = get_piece_color(piece.type);
+    for(i32 y = 0; y < 4; y++){
+        for(i32 x = 0; x < 4; x++){
+            if(piece_cell(piece, x, y))
                 draw_tile(p_x + x, p_y + y, color, PieceSprite);
-            }
         }
     }
 }
 
-void draw_piece_free(f32 p_x, f32 p_y, const Piece *piece){
-    for(i32 y = 0; y < piece->side; y++){
-        for(i32 x = 0; x < piece->side; x++){
-            if(piece->bitmap[y * piece->side + x]){
-                Vec4 color = get_piece_color(piece->type);
+void draw_piece_free(f32 p_x, f32 p_y, Piece piece){
+    Vec4 color = get_piece_color(piece.type);
+    for(i32 y = 0; y < 4; y++){
+        for(i32 x = 0; x < 4; x++){
+            if(piece_cell(piece, x, y))
                 draw_sprite(p_x + x * BlockSize, p_y + y * BlockSize, 1.0f, color, PieceSprite);
-            }
         }
     }
 }
 
-b32 piece_collided(i32 x, i32 y, const Piece *p){
-    for(i32 i = 0; i < p->side; i++){
-        for(i32 j = 0; j < p->side; j++){
-            i32 p_x = x + j;
-            i32 p_y = y + i;
-            if(p->bitmap[i * p->side + j] == 0) continue;
-
-            if(p_x >= GridW || p_x < 0 || p_y >= GridH || p < 0)
-                return true;
-            if(Grid[p_y][p_x])
-                return true;
-        }
-    }
-    return false;
-}
-
-struct{
-    i32 buffer[GridH];
-    i32 count;
-}GapeQueue = {.count = 0};
-
-typedef struct{
-    i32 size;
-    i32 capacity;
-    i32 *buffer;
-}Stack;
-
 b32 highscore_placement(i32 score, const Scoreboard *board){
     for(i32 i = 0; i < board->count; i++){
         if(score > board->score[i].score)
@@ -343,12 +166,15 @@ b32 highscore_placement(i32 score, const Scoreboard *board){
     return board->count + 1;
 }
 
+// A font that fails to load is left empty, its text just doesn't draw
 Font load_system_font(const char *name, i32 font_size){
     char font_path[256] = {0};
-    os_font_path(font_path, sizeof(font_path), "\\Fonts\\");
-    b32 result = strcat_s(font_path, array_size(font_path), name) == 0;
-    assert(result);
-    return load_font(font_path, font_size);
+    Font font;
+    if(!load_font(&font, os_font_path(font_path, sizeof(font_path), name), font_size)){
+        debug_message(Red_v4, "Failed to load font %s at size %d!", name, font_size);
+        set_zero(&font, sizeof(font));
+    }
+    return font;
 }
 
 GameControls default_game_controls(void){
@@ -375,9 +201,9 @@ GameControls load_controls_configuration(void){
     return default_game_controls();
 }
 
-void engine_init(void){
+void engine_init(RenderBackend *backend){
     b32 result;
-    init_renderer();
+    init_renderer(backend);
     init_fonts();
 
     BigFont     = load_system_font("Arial.ttf", 36);
@@ -385,25 +211,30 @@ void engine_init(void){
     DebugFont   = load_system_font("Consola.ttf", 16);
     set_font(&DefaultFont);
 
-    Aim.next_piece = random_piece();
-    spawn_next_piece();
+    game_instance_init(&Game, RecordingRuns, REPLAY_RUN_CAPACITY);
+    restart_game(&Game, true);
 
-    TextureInfo tile_atlas = load_texture("data\\tile_sprite.png");
+    Sprite tiles;
+    result = load_sprite_sheet(&tiles, "data/tile_sprite.png");
+    if(!result){
+        debug_message(Red_v4, "Failed to load the tile sprites!");
+        set_zero(&tiles, sizeof(tiles));
+    }
 
     BorderSprite = (Sprite){
-        .x = 0,
-        .y = 0,
+        .x = tiles.x,
+        .y = tiles.y,
         .w = (i32)BlockSize,
         .h = (i32)BlockSize,
-        .atlas = tile_atlas,
+        .atlas = tiles.atlas,
     };
 
     PieceSprite = (Sprite){
-        .x = 2 * (i32)BlockSize,
-        .y = 0,
+        .x = tiles.x + 2 * (i32)BlockSize,
+        .y = tiles.y,
         .w = (i32)BlockSize,
         .h = (i32)BlockSize,
-        .atlas = tile_atlas,
+        .atlas = tiles.atlas,
     };
 
     BackgroundSprite = PieceSprite;
@@ -421,13 +252,13 @@ void engine_init(void){
     }
 
     //BackgroundSound = load_wave_file("C:\\Windows\\Media\\Ring10.wav");
-    CursorSound     = load_wave_file("data\\audio\\ui_move.wav");
-    MovePieceSound  = load_wave_file("data\\audio\\move_piece.wav");
-    LockPieceSound  = load_wave_file("data\\audio\\lock_piece.wav");
-    RotatePiece     = load_wave_file("data\\audio\\rotate_piece.wav");
-    GameOverSound   = load_wave_file("data\\audio\\gameover.wav");
-    ScoreSound      = load_wave_file("data\\audio\\score.wav");
-    TetrisSound     = load_wave_file("data\\audio\\tetris.wav");
+    CursorSound     = load_wave_file("data/audio/ui_move.wav");
+    MovePieceSound  = load_wave_file("data/audio/move_piece.wav");
+    LockPieceSound  = load_wave_file("data/audio/lock_piece.wav");
+    RotatePiece     = load_wave_file("data/audio/rotate_piece.wav");
+    GameOverSound   = load_wave_file("data/audio/gameover.wav");
+    ScoreSound      = load_wave_file("data/audio/score.wav");
+    TetrisSound     = load_wave_file("data/audio/tetris.wav");
 
     //play_sound(BackgroundSound, 0.2f, true);
 }
@@ -440,6 +271,7 @@ void draw_background(i32 t_x, i32 t_y){
     const Vec4 bg_color0 = vec4_color(0xff202020);
     const Vec4 bg_color1 = vec4_color(0xff303030);
 
+    set_layer(LAYER_BACKGROUND);
     i32 offset = 0;
     for(i32 y = t_y; y < t_y + GridH; y++){
         for(i32 x = t_x; x < t_x + GridW; x++){
@@ -450,15 +282,18 @@ void draw_background(i32 t_x, i32 t_y){
     }
 }
 
-void draw_grid(i32 t_x, i32 t_y){
-    const i32 tetris_line_start = GapeQueue.buffer[0];
-    const i32 tetris_line_end   = GapeQueue.buffer[MAX(GapeQueue.count - 1, 0)];
+void draw_grid(const GameInstance *game, i32 t_x, i32 t_y){
+    const SimState *sim = &game->sim;
+    const i32 tetris_line_start = sim->gape_queue.buffer[0];
+    const i32 tetris_line_end   = sim->gape_queue.buffer[MAX(sim->gape_queue.count - 1, 0)];
 
     const i32 t_x2 = t_x - 1;
     const i32 t_y2 = t_y - 1;
     const i32 margin_w = GridW + 2;
     const i32 margin_h = GridH + 2;
 
+    set_layer(LAYER_SCENE);
+
     // border
     Vec4 border_color = Vec4(0.2f, 0.2f, 0.35f, 1.0f);
     for(i32 y = 0; y < margin_h; y++){
@@ -474,11 +309,11 @@ void draw_grid(i32 t_x, i32 t_y){
     // grid
     for(i32 y = 0; y < GridH; y++){
         for(i32 x = 0; x < GridW; x++){
-            i32 tile = Grid[y][x];
+            i32 tile = sim->grid.colors[y][x];
             if(tile){
                 Vec4 color = get_piece_color(tile);
-                if(StreakOn && y >= tetris_line_start && y <= tetris_line_end){ // animate tetris
-                    f32 ms = StreakTimer * 100.0f;
+                if(sim->streak_on && y >= tetris_line_start && y <= tetris_line_end){ // animate tetris
+                    f32 ms = (f32)sim->streak_timer / SIM_TICK_RATE * 100.0f;
                     Vec4 blink_color = (i32)ms % 10 < 5? invert_color(color) : White_v4;
                     draw_tile(t_x + x, t_y + y, blink_color, PieceSprite);
                 } else {
@@ -489,74 +324,93 @@ void draw_grid(i32 t_x, i32 t_y){
     }
 }
 
-void draw_grid_debug(i32 t_x, i32 t_y){
+void draw_grid_debug(const GameInstance *game, i32 t_x, i32 t_y){
+    set_layer(LAYER_TEXT);
     for(i32 y = 0; y < GridH; y++){
         for(i32 x = 0; x < GridW; x++){
-            i32 tile = Grid[y][x];
+            i32 tile = game->sim.grid.colors[y][x];
             draw_text((x + t_x) * BlockSize, (y + t_y) * BlockSize, tile? invert_color(get_piece_color(tile)) : White_v4, "%d", tile);
         }
     }
 }
 
-b32 is_game_running(void){
-    return !((GameMode != GM_Running) | GameOver | GamePause);
+b32 is_game_running(const GameInstance *game){
+    return !((GameMode != GM_Running) | game->sim.game_over | game->pause);
 }
 
-void update_grid(void){
-    if(!is_game_running()) return;
-    if(StreakOn){
-        if(StreakTimer <= 0){
-            StreakOn = false;
-        } else {
-            StreakTimer -= TimeElapsed;
-            return;
-        }
-    } else {
-        // Scan for complete lines to clear
-        i32 streak = 0;
-        for(i32 y = 0; y < GridH; y++){
-            b32 is_filled = true;
-            for(i32 x = 0; x < GridW; x++){
-                if(Grid[y][x] == BlinkTile || Grid[y][x] == 0){
-                    is_filled = false;
-                    break;
-                }
-            }
-            if(is_filled){
-                streak++;
-                GapeQueue.buffer[GapeQueue.count++] = y;
-            }
-        }
+static u32 game_input_bits(void){
+    u32 input = 0;
+    if(get_key(Controls.left).state)         input |= SIM_INPUT_LEFT;
+    if(get_key(Controls.right).state)        input |= SIM_INPUT_RIGHT;
+    if(get_key(Controls.down).state)         input |= SIM_INPUT_DOWN;
+    if(get_key(Controls.rotate_left).state)  input |= SIM_INPUT_ROTATE_LEFT;
+    if(get_key(Controls.rotate_right).state) input |= SIM_INPUT_ROTATE_RIGHT;
+    return input;
+}
 
-        if(streak){ // If nothing new here remove this if
-            Score += streak * 1000;
+static void play_game_sounds(u32 events){
+    if(events & SIM_EVENT_ROTATE)    play_sound(RotatePiece, 1.0f, false);
+    if(events & SIM_EVENT_MOVE)      play_sound(MovePieceSound, 0.5f, false);
+    if(events & SIM_EVENT_LOCK)      play_sound(LockPieceSound, 1.0f, false);
+    if(events & SIM_EVENT_TETRIS)    play_sound(TetrisSound, 1.0f, false);
+    if(events & SIM_EVENT_SCORE)     play_sound(ScoreSound, 1.0f, false);
+    if(events & SIM_EVENT_GAME_OVER) play_sound(GameOverSound, 1.0f, false);
+}
 
-            if(streak >= 4){
-                StreakTimer = 1.0f;
-                StreakOn = true;
-                play_sound(TetrisSound, 1.0f, false);
-                return;
-            } else {
-                play_sound(ScoreSound, 1.0f, false);
-            }
-        }
+// The simulation only advances in whole ticks. Frame time goes into an
+// accumulator and whatever is left over is used to blend the aim piece
+// between its last two tick positions.
+#define MAX_FRAME_TICKS (SIM_TICK_RATE / 4) // longest hitch we catch up on
+
+void update_game(GameInstance *game, u32 input){
+    SimState *sim = &game->sim;
+    if(!is_game_running(game)){
+        game->tick_accumulator = 0;
+        game->tick_alpha = 1.0f;
+        return;
     }
 
-    // Push blocks down
-    i32 index = 0;
-    while(index < GapeQueue.count){
-        i32 goal_line = GapeQueue.buffer[index++];
-        i32 *line = Grid[goal_line];
-        for(i32 y = goal_line - 1; y >= 0; y--){
-            memcpy(line, Grid[y], sizeof(i32) * GridW);
-            line = Grid[y];
+    game->tick_accumulator += TimeElapsed * SIM_TICK_RATE;
+    i32 ticks = (i32)game->tick_accumulator;
+    game->tick_accumulator -= ticks;
+    ticks = MIN(ticks, MAX_FRAME_TICKS);
+
+    u32 events = 0;
+    for(i32 tick = 0; tick < ticks; tick++){
+        u32 tick_input = input;
+        if(game->replay_playing && !replay_next_input(&game->playback, &tick_input)){
+            game->replay_playing = false;
+            debug_message(Yellow_v4, "Replay finished!");
+        }
+        replay_record(&game->recording, tick_input);
+
+        b32 autoplay = game->autoplay && !game->replay_playing;
+        if(autoplay) tick_input = SIM_INPUT_DOWN;
+
+        game->previous_aim.x = sim->aim.x;
+        game->previous_aim.y = sim->aim.y;
+        game->previous_aim.piece = sim->aim.piece;
+        events |= sim_step(sim, tick_input, 1);
+
+        if(autoplay && game->autoplay_piece != sim->piece_count && !sim->aim.piece_setted){
+            game->autoplay_piece = sim->piece_count;
+            BotDecision decision = bot_think(&AutoBot, sim);
+            if(decision.found)
+                events |= sim_apply_moves(sim, decision.path, decision.path_count);
+            game->previous_aim.x = sim->aim.x;
+            game->previous_aim.y = sim->aim.y;
+            game->previous_aim.piece = sim->aim.piece;
         }
     }
-    GapeQueue.count = 0;
+    game->tick_alpha = (f32)game->tick_accumulator;
+    play_game_sounds(events);
+
+    if(events & SIM_EVENT_GAME_OVER && !game->autoplay_used)
+        save_replay(game);
 }
 
-void save_grid(void){ // @debug
-    b32 result = os_write_to_file(Grid, sizeof(Grid), DEBUG_GRID_FILE_NAME);
+void save_grid(GameInstance *game){ // @debug
+    b32 result = os_write_to_file(&game->sim.grid, sizeof(game->sim.grid), DEBUG_GRID_FILE_NAME);
     if(!result){
         debug_message(Red_v4, "Can't write file!");
         return;
@@ -564,138 +418,142 @@ void save_grid(void){ // @debug
     debug_message(Green_v4, "Grid saved!");
 }
 
-void load_grid(void){ // @debug
-    b32 result = os_read_file(Grid, sizeof(Grid), DEBUG_GRID_FILE_NAME);
+void load_grid(GameInstance *game){ // @debug
+    b32 result = os_read_file(&game->sim.grid, sizeof(game->sim.grid), DEBUG_GRID_FILE_NAME);
     if(!result){
         debug_message(Red_v4, "Can't read file!");
         return;
     }
-    restart_game(false);
+    restart_game(game, false);
     debug_message(Green_v4, "Grid loaded!");
 }
 
-void restart_game(b32 clear_grid){
-    if(clear_grid){
-        memset(Grid, 0, sizeof(Grid)); // clean grid
-    }
-    Aim.next_piece = random_piece();
-    spawn_next_piece();
-    GravityCount = 0;
-    Score = 0;
-    GameOver = false;
-    GamePause = false;
-    memset(PieceStatistics, 0, sizeof(PieceStatistics));
+void save_replay(GameInstance *game){ // @debug
+    i32 size = replay_encoded_size(&game->recording);
+    u8 *buffer = os_memory_alloc(size);
+    replay_encode(&game->recording, buffer, size);
+    b32 result = os_write_to_file(buffer, size, REPLAY_FILE_NAME);
+    os_memory_free(buffer);
+    if(!result){
+        debug_message(Red_v4, "Can't write replay!");
+        return;
+    }
+    debug_message(Green_v4, "Replay saved! %d ticks", game->recording.header.tick_count);
+}
+
+void load_replay(GameInstance *game){ // @debug
+    i32 size;
+    u8 *data = os_read_whole_file(REPLAY_FILE_NAME, &size);
+    if(!data || !replay_decode(&game->playback, data, size)){
+        if(data) os_memory_free(data);
+        debug_message(Red_v4, "Can't read replay!");
+        return;
+    }
+    if(game->playback_data) os_memory_free(game->playback_data);
+    game->playback_data = data;
+
+    replay_start_playback(&game->playback, &game->sim);
+    replay_begin(&game->recording, &game->sim, game->recording_runs, game->recording_capacity);
+    game->replay_playing = true;
+    game->pause = false;
+    debug_message(Green_v4, "Replaying %d ticks", game->playback.header.tick_count);
+}
+
+void game_instance_init(GameInstance *game, u16 *recording_runs, i32 recording_capacity){
+    set_zero(game, sizeof(*game));
+    game->recording_runs = recording_runs;
+    game->recording_capacity = recording_runs? recording_capacity : 0;
+    game->tick_alpha = 1.0f;
+}
+
+// Reseeds on every restart so the recording always starts from sim_init
+void restart_game(GameInstance *game, b32 clear_grid){
+    Board grid = game->sim.grid;
+    sim_init(&game->sim, random_u64() | 1);
+    if(!clear_grid) sim_set_board(&game->sim, &grid);
+    game->sim.falling = Debug.falling;
+    replay_begin(&game->recording, &game->sim, game->recording_runs, game->recording_capacity);
+    game->replay_playing = false;
+    game->autoplay_used = game->autoplay;
+    game->autoplay_piece = 0;
+    game->pause = false;
 }
 
-void draw_statistics(i32 x, i32 y){
+void toggle_autoplay(GameInstance *game){
+    if(!AutoBotReady){
+        bot_init(&AutoBot, job_cpu_count());
+        AutoBotReady = true;
+    }
+    game->autoplay = !game->autoplay;
+    if(game->autoplay) game->autoplay_used = true;
+    game->autoplay_piece = 0;
+    debug_message(Yellow_v4, "Autoplay %s", game->autoplay? "on" : "off");
+}
+
+void draw_statistics(const GameInstance *game, i32 x, i32 y){
+    const SimState *sim = &game->sim;
     i32 w = 5;
     i32 h = 4;
 
-    draw_text(x * BlockSize, (y - 1) * BlockSize, White_v4, "Score:%d", Score);
+    set_layer(LAYER_TEXT);
+    draw_text(x * BlockSize, (y - 1) * BlockSize, White_v4, "Score:%d", sim->score);
     Vec4 panel_color = Vec4(0.2f, 0.2f, 0.2f, 1.0f);
+    set_layer(LAYER_BACKGROUND);
     draw_rect(x * BlockSize, y * BlockSize, w * BlockSize, h * BlockSize, panel_color);
-    //draw_piece(x + 1, y + 1, &Aim.next_piece);
-    f32 center_x = x + (w - Aim.next_piece.side) * 0.5f;
-    f32 center_y = y + (h - Aim.next_piece.side) * 0.5f;
-    draw_piece_free(center_x * (f32)BlockSize, center_y * (f32)BlockSize, &Aim.next_piece);
+    set_layer(LAYER_SCENE);
+    const PieceShape *next = piece_shape(sim->aim.next_piece);
+    f32 center_x = x + (w - next->box.w) * 0.5f - next->box.x;
+    f32 center_y = y + (h - next->box.h) * 0.5f - next->box.y;
+    draw_piece_free(center_x * (f32)BlockSize, center_y * (f32)BlockSize, sim->aim.next_piece);
 
     i32 b_y = 1;
     i32 b_x = 2;
 
-    for(i32 i = 0; i < array_size(Pieces); i++){
-        const Piece *p = Pieces[i];
+    for(i32 i = 0; i < PIECE_COUNT; i++){
+        Piece p = {.type = (u8)(i + 1), .rotation = 0};
         i32 offset_y = i * 3;
         draw_piece(b_x, b_y + offset_y, p);
     }
 
+    set_layer(LAYER_TEXT);
     draw_centered_text((b_x + 2) * BlockSize, b_y * BlockSize * 0.6f, White_v4, "-Statistics-");
-    for(i32 i = 0; i < array_size(Pieces); i++){
+    for(i32 i = 0; i < PIECE_COUNT; i++){
         i32 offset_y = i * 3;
-        draw_text((b_x + 5) * BlockSize, (b_y + offset_y + 1) * BlockSize, White_v4, "%d", PieceStatistics[i]);
-    }
-}
-
-void move_piece(void){
-    if(!is_game_running() | StreakOn) return;
-
-    if(key_pressed(get_key(Controls.rotate_left))){
-        Piece new_pos = Aim.piece;
-        rotate_piece(&new_pos, -1);
-        if(!piece_collided(Aim.x, Aim.y, &new_pos)){
-            Aim.piece = new_pos;
-            play_sound(RotatePiece, 1.0f, false);
-        }
-    } else if(key_pressed(get_key(Controls.rotate_right))){
-        Piece new_pos = Aim.piece;
-        rotate_piece(&new_pos, 1);
-        if(!piece_collided(Aim.x, Aim.y, &new_pos)){
-            Aim.piece = new_pos;
-            play_sound(RotatePiece, 1.0f, false);
-        }
-    }
-
-    static f32 delay_time = 1.0f / 10.0f;
-    static f32 delay  = 0;
-
-    static i32 lock_key  = 0;
-    static i32 direction = 0;
-    if(key_pressed(get_key(Controls.left))){
-        lock_key  = Controls.left;
-        direction = -1;
-    }
-    if(key_pressed(get_key(Controls.right))){
-        lock_key  = Controls.right;
-        direction = 1;
-    }
-
-    if(get_key(lock_key).state){
-        if(delay >= delay_time){
-            i32 new_pos = Aim.x + 1 * direction;
-            if(!piece_collided(new_pos, Aim.y, &Aim.piece)){
-                Aim.x = new_pos;
-                play_sound(MovePieceSound, 0.5f, false);
-            }
-            delay = 0;
-        }
-    } else {
-        lock_key = 0;
-    }
-    delay += TimeElapsed;
-
-    if(get_key(Controls.down).state)
-        GravityCount += TimeElapsed * 10;
-
-    if(Debug.falling)
-        GravityCount += TimeElapsed;
-    if(GravityCount >= MoveDownTime){
-        Aim.y += 1;
-        GravityCount = 0;
-        if(piece_collided(Aim.x, Aim.y, &Aim.piece)){
-            set_piece(Aim.x, Aim.y - 1, &Aim.piece);
-            Aim.piece_setted = true;
-            play_sound(LockPieceSound, 1.0f, false);
-        }
+        draw_text((b_x + 5) * BlockSize, (b_y + offset_y + 1) * BlockSize, White_v4, "%d", sim->piece_statistics[i]);
     }
 }
 
 enum GameModes GameMode = GM_Menu;
 
-void draw_scene(void){
-
+void draw_scene(const GameInstance *game){
+    PROFILE_BEGIN("draw_scene");
     clear_screen(Vec4(0.1f, 0.1f, 0.1f, 0.0f));
 
     const i32 t_x = (WWIDTH / (i32)BlockSize - GridW) / 2;
     const i32 t_y = 1;
 
     draw_background(t_x, t_y);
-    draw_grid(t_x, t_y);
+    draw_grid(game, t_x, t_y);
     if(Keyboard.n0.state)
-        draw_grid_debug(t_x, t_y);
+        draw_grid_debug(game, t_x, t_y);
     // draw aim piece
-    if(!Aim.piece_setted)
-        draw_piece(t_x + Aim.x, t_y + Aim.y, &Aim.piece);
+    const SimState *sim = &game->sim;
+    if(!sim->aim.piece_setted){
+        f32 x = (f32)sim->aim.x;
+        f32 y = (f32)sim->aim.y;
+        Piece previous = game->previous_aim.piece;
+        b32 same_piece = previous.type == sim->aim.piece.type && previous.rotation == sim->aim.piece.rotation;
+        b32 one_step   = abs(game->previous_aim.x - sim->aim.x) <= 1 && abs(game->previous_aim.y - sim->aim.y) <= 1;
+        if(same_piece && one_step){ // a fresh spawn or a debug teleport just snaps
+            x = lerp((f32)game->previous_aim.x, x, game->tick_alpha);
+            y = lerp((f32)game->previous_aim.y, y, game->tick_alpha);
+        }
+        set_layer(LAYER_SCENE);
+        draw_piece_free((t_x + x) * BlockSize, (t_y + y) * BlockSize, sim->aim.piece);
+    }
 
-    draw_statistics(t_x + GridW + 3, 3);
+    draw_statistics(game, t_x + GridW + 3, 3);
+    PROFILE_END();
 }
 
 void prompt(void){
@@ -707,14 +565,14 @@ void prompt(void){
 
     if(key_pressed(get_key(Controls.confirme))){
         if(confirmation_prompt_cursor == 1){
-            restart_game(true);
+            restart_game(&Game, true);
             debug_message(Green_v4, "Restarted!");
         }
         GameMode = GM_Running;
         confirmation_prompt_cursor = false;
     }
 
-    draw_scene();
+    draw_scene(&Game);
     Font *font_backup = CurrentFont;
     set_font(&BigFont);
     const f32 center_y = (f32)(WHEIGHT / 3);
@@ -724,7 +582,9 @@ void prompt(void){
     b32 this = confirmation_prompt_cursor;
     Vec4 color = Black_v4;
     color.w = 0.3f;
+    set_layer(LAYER_OVERLAY);
     draw_rect(0, 0, WWIDTH, WHEIGHT, color);
+    set_layer(LAYER_OVERLAY_TEXT);
     draw_centered_text(center_x, center_y + line_space * line++, Red_v4, "Reset game?");
     draw_centered_text(center_x, center_y + line_space * line++, this == 0? White_v4 : brightness(White_v4, 0.3f), "NO");
     draw_centered_text(center_x, center_y + line_space * line++, this == 1? White_v4 : brightness(White_v4, 0.3f), "YES");
@@ -732,15 +592,23 @@ void prompt(void){
 }
 
 void game_running(void){
+    PROFILE_BEGIN("game_running");
+    GameInstance *game = &Game;
+    SimState *sim = &game->sim;
+
     // @DEBUG Save/Load grid
     if(Keyboard.r_ctrl.state && key_pressed(Keyboard.s))
-        save_grid();
+        save_grid(game);
     if(Keyboard.r_ctrl.state && key_pressed(Keyboard.l)){
-        load_grid();
+        load_grid(game);
     }
+    if(Keyboard.r_ctrl.state && key_pressed(Keyboard.r))
+        save_replay(game);
+    if(Keyboard.r_ctrl.state && key_pressed(Keyboard.p))
+        load_replay(game);
     if(Keyboard.r_ctrl.state && Keyboard.n.state){
-        spawn_next_piece();
-        PieceStatistics[Aim.piece.type - 1]++;
+        sim_spawn_next_piece(sim);
+        sim->piece_statistics[sim->aim.piece.type - 1]++;
     }
 
     // @Temp Force save
@@ -754,42 +622,35 @@ void game_running(void){
         confirmation_prompt_open = false;
         GameMode = GM_Prompt;
     } else if(key_pressed(get_key(Controls.confirme)) && !confirmation_prompt_open){ // Pause game
-        if(GameOver){
-            i32 placement = highscore_placement(Score, &HighScore);
+        if(sim->game_over){
+            i32 placement = highscore_placement(sim->score, &HighScore);
             if(placement <= array_size(HighScore.score)){
-                insert_in_scoreboard(Score, placement);
+                insert_in_scoreboard(sim->score, placement);
                 init_highscore_menu_in_insert_mode(placement);
             } else {
-                restart_game(true);
+                restart_game(game, true);
             }
         } else {
-            GamePause = !GamePause;
-        }
-    }
-
-    if(Aim.piece_setted && !StreakOn){
-        if(!try_spawn_next_piece()){
-            GameOver = true;
-            play_sound(GameOverSound, 1.0f, false);
+            game->pause = !game->pause;
         }
     }
 
-    move_piece();
-    update_grid();
-    draw_scene();
+    update_game(game, game_input_bits());
+    draw_scene(game);
 
     // Debug Controls
-    if(key_pressed(Keyboard.x)) Debug.falling = !Debug.falling;
+    if(key_pressed(Keyboard.x)) sim->falling = Debug.falling = !Debug.falling;
+    if(key_pressed(Keyboard.b)) toggle_autoplay(game);
     if(key_pressed(Keyboard.m)){
         Debug.mode++;
         if(Debug.mode >= debug_modes) Debug.mode = 1;
         debug_message(Red_v4, "Debug mode set [%s]", DebugModesNames[Debug.mode]);
-        Debug.falling = false;
+        sim->falling = Debug.falling = false;
     }
 
     static i32 piece_index = 0; // @Debug
     if(key_pressed(Keyboard.z)){
-        piece_index = (piece_index + 1) % array_size(Pieces);
+        piece_index = (piece_index + 1) % PIECE_COUNT;
     }
 
     const i32 t_x = (WWIDTH / (i32)BlockSize - GridW) / 2;
@@ -797,31 +658,33 @@ void game_running(void){
 
     // Debug Modes
     {
+        set_layer(LAYER_SCENE);
         i32 m_x = Mouse.x / (i32)BlockSize - t_x;
         i32 m_y = Mouse.y / (i32)BlockSize - t_y;
 
         if(m_x >= 0 && m_x < GridW && m_y >= 0 && m_y < GridH){
-            assert(piece_index <= array_size(Pieces));
-            const Piece *piece = Pieces[piece_index];
+            assert(piece_index < PIECE_COUNT);
+            Piece piece = {.type = (u8)(piece_index + 1), .rotation = 0};
 
             if(Debug.mode == place_aim){
-                if(Mouse.left.state && !StreakOn){
-                    Aim.piece = *piece;
-                    Aim.x = m_x - 1;
-                    Aim.y = m_y - 1;
-                    GravityCount = 0;
+                if(Mouse.left.state && !sim->streak_on){
+                    sim->aim.piece = piece;
+                    sim->aim.x = m_x - 1;
+                    sim->aim.y = m_y - 1;
+                    sim->gravity_count = 0;
                 }
                 draw_piece(t_x + m_x - 1, t_y + m_y - 1, piece);
             } else if(Debug.mode == place_piece){
-                if(Mouse.left.state && !StreakOn)
-                    set_piece(m_x - 1, m_y - 1, piece);
+                if(Mouse.left.state && !sim->streak_on)
+                    sim_set_piece(sim, m_x - 1, m_y - 1, piece);
                 draw_piece(t_x + m_x - 1, t_y + m_y - 1, piece);
             } else if(Debug.mode == paint){
+                set_layer(LAYER_OVERLAY);
                 draw_rect((f32)(Mouse.x - Mouse.x % (i32)BlockSize), (f32)(Mouse.y - Mouse.y % (i32)BlockSize), BlockSize, BlockSize, Red_v4);
-                if(Mouse.left.state && !StreakOn)
-                    Grid[m_y][m_x] = 1;
-                else if(Mouse.right.state && !StreakOn)
-                    Grid[m_y][m_x] = 0;
+                if(Mouse.left.state && !sim->streak_on)
+                    sim_set_cell(sim, m_x, m_y, 1);
+                else if(Mouse.right.state && !sim->streak_on)
+                    sim_set_cell(sim, m_x, m_y, 0);
 
             } else {
                 assert(Debug.mode == none);
@@ -831,13 +694,14 @@ void game_running(void){
 
     // Overlay
     {
+        set_layer(LAYER_TEXT);
         f32 center_x = (t_x + GridW / 2) * BlockSize;
         f32 center_y = (t_y + GridH / 2) * BlockSize;
-        if(GameOver)
+        if(sim->game_over)
             draw_centered_text(center_x, center_y, Red_v4, "GameOver!");
-        if(GamePause)
+        if(game->pause)
             draw_centered_text(center_x, center_y, White_v4, "-Pause-");
-        if(StreakOn)
+        if(sim->streak_on)
             draw_centered_text(center_x, center_y, White_v4, "Tetris!");
     }
 
@@ -850,9 +714,11 @@ void game_running(void){
         KeyNames[Controls.rotate_right],
         KeyNames[Controls.restart]
     );
+    PROFILE_END();
 }
 
 void engine_update(void){
+    PROFILE_BEGIN("engine_update");
     if(GameMode == GM_Menu){
         menu();
     } else if(GameMode == GM_Running){
@@ -865,12 +731,21 @@ void engine_update(void){
 
     update_messages(); // @Debug
 
+    // @Debug
+    if(Keyboard.r_ctrl.state && key_pressed(Keyboard.t)){
+        if(profiler_dump_trace(TRACE_FILE_NAME))
+            debug_message(Green_v4, "Trace saved to %s", TRACE_FILE_NAME);
+        else
+            debug_message(Red_v4, "Can't write trace!");
+    }
+
     // @Debug
     static f32 time_count = 0;
     time_count += TimeElapsed;
+    set_layer(LAYER_DEBUG_TEXT);
     draw_text(WWIDTH / 2, 0, Yellow_v4, "%.2f", time_count);
     show_rederer_debug_info(0, 0);
     execute_draw_commands();
-    FrameDrawCallsCount = 0;
-    FrameVertexCount    = 0;
+    reset_frame_stats();
+    PROFILE_END();
 }
\ No newline at end of file
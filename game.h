@@ -1,16 +1,11 @@
 #pragma once
 
 #include "basic.h"
+#include "simulation.h"
+#include "replay.h"
 
 // New Suff
 
-typedef struct {
-    i32 side;
-    i32 type;
-    i32 bitmap[4 * 4];
-}Piece;
-extern const Piece *Pieces[7];
-
 typedef struct{
     u32 id;
     i32 width, height;
@@ -30,6 +25,38 @@ enum GameModes{
 
 extern enum GameModes GameMode;
 
+// One board: the rules state plus what the game layer keeps next to it.
+// Nothing in here is shared, so any number of them can run side by side.
+typedef struct{
+    SimState sim;
+    b32 pause;
+
+    // every game is recorded from its first tick, see save_replay
+    Replay recording;
+    u16 *recording_runs; // NULL to not record
+    i32 recording_capacity;
+    Replay playback;
+    u8 *playback_data;
+    b32 replay_playing;
+
+    // autoplay drives the piece through sim_apply_moves instead of the
+    // input bits, so games it touched can't be replayed
+    b32 autoplay;
+    b32 autoplay_used;
+    i32 autoplay_piece; // sim.piece_count the bot last moved
+
+    // fixed tick accumulator and the aim position one tick back, for
+    // interpolation
+    f64 tick_accumulator;
+    f32 tick_alpha;
+    struct{
+        i32 x, y;
+        Piece piece;
+    }previous_aim;
+}GameInstance;
+
+extern GameInstance Game;
+
 //
 // Menu
 //
@@ -66,6 +93,8 @@ typedef struct{
 #define SAVE_DATA_VERSION 1
 
 #define DEBUG_GRID_FILE_NAME "grid.dat" // @Debug
+#define REPLAY_FILE_NAME "replay.rpl" // @Debug
+#define TRACE_FILE_NAME "trace.json" // @Debug
 
 extern Scoreboard HighScore;
 
@@ -73,7 +102,15 @@ extern const char *HighScoreFileName;
 b32 save_data_to_disk(void);
 void insert_in_scoreboard(i32 score, i32 placement);
 void init_highscore_menu_in_insert_mode(i32 board_position);
-void restart_game(b32 clear_grid);
+void game_instance_init(GameInstance *game, u16 *recording_runs, i32 recording_capacity);
+void restart_game(GameInstance *game, b32 clear_grid);
+void update_game(GameInstance *game, u32 input);
+void save_replay(GameInstance *game);
+void load_replay(GameInstance *game);
+void toggle_autoplay(GameInstance *game);
+void game_running(void);
+void draw_scene(const GameInstance *game);
+void prompt(void);
 
 void debug_message(Vec4 color, const char *format, ...);
 
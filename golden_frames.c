@@ -0,0 +1,388 @@
+// Golden image regression run: renders fixed game frames offscreen with
+// the raster backend and compares them against the PNGs stored in
+// data/golden. It reports each frame's cost too, so visual and
+// performance regressions in draw_grid, draw_statistics, the menus and
+// text show up on machines without a gpu. Builds the real game code with
+// headless.c, run it from the repo root.
+//
+//   golden_frames [-u] [-d dir] [-o dir] [-t tolerance] [-p pixels] [-n repeats]
+//                 [-j threads] [-g grid.dat] [-r replay.rpl -f frame[,frame...]]
+//
+// -u writes the frames as the new goldens instead of comparing.
+// -t is how far apart a channel can be and still match, -p how many
+// pixels can differ before the frame fails. Failed frames are written to
+// the -o dir (build/golden) to look at. -g and -r add frames of a saved
+// board or of a replay at the given frame numbers (60 a second), they are
+// compared against grid.png and replay_<frame>.png.
+//
+// Text goes through FreeType with the fonts headless.c picks, goldens made
+// with another FreeType or other fonts need a bigger tolerance.
+
+#include "engine.h"
+#include "game.h"
+#include "renderer.h"
+#include "raster.h"
+#include "png_writer.h"
+#include "stb_image.h"
+
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define FRAME_TIME (1.0f / 60.0f)
+#define MAX_REPLAY_FRAMES 64
+
+typedef struct{
+    const char *name;
+    void (*setup)(void); // runs once, whatever state the frame needs
+    void (*draw)(void);  // records one frame, the same one every call
+}Scene;
+
+typedef struct{
+    b32 update;
+    const char *golden_dir;
+    const char *out_dir;
+    i32 tolerance;
+    i32 max_pixels;
+    i32 repeats;
+    i32 threads;
+    const char *grid_file;
+    const char *replay_file;
+    i32 replay_frames[MAX_REPLAY_FRAMES];
+    i32 replay_frame_count;
+}Options;
+
+static Options Opt = {
+    .golden_dir = "data/golden",
+    .out_dir = "build/golden",
+    .tolerance = 2,
+    .max_pixels = 0,
+    .repeats = 10,
+};
+
+static Raster Target;
+static i32 Failures;
+static i32 ReplayFrame; // last frame the replay was stepped to
+
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+
+// A board with some rows filled (one hole each, so they never clear)
+static void start_game(i32 rows){
+    set_seed(0x5eed);
+    GameMode = GM_Running;
+    restart_game(&Game, true);
+    Game.autoplay_used = true; // keeps update_game from saving a replay on game over
+    for(i32 y = GridH - rows; y < GridH; y++){
+        for(i32 x = 0; x < GridW; x++){
+            if(x != (y * 3) % GridW)
+                sim_set_cell(&Game.sim, x, y, 1 + (x + y) % PIECE_COUNT);
+        }
+    }
+}
+
+static void play_frames(i32 frames, u32 (*input)(i32 frame)){
+    TimeElapsed = FRAME_TIME;
+    for(i32 i = 0; i < frames; i++)
+        update_game(&Game, input? input(i) : 0);
+    TimeElapsed = 0;
+}
+
+static u32 scripted_input(i32 frame){
+    if(frame < 12)                  return SIM_INPUT_LEFT;
+    if(frame >= 30 && frame < 34)   return SIM_INPUT_ROTATE_RIGHT;
+    if(frame >= 60 && frame < 100)  return SIM_INPUT_DOWN;
+    if(frame >= 130 && frame < 140) return SIM_INPUT_RIGHT;
+    return 0;
+}
+
+// game_running with no time passing only draws
+static void draw_game(void){
+    game_running();
+}
+
+static void setup_game(void){
+    start_game(8);
+    play_frames(160, scripted_input);
+}
+
+static void setup_pause(void){
+    Game.pause = true;
+}
+
+static void setup_prompt(void){
+    Game.pause = false;
+    GameMode = GM_Prompt;
+}
+
+static void draw_prompt(void){
+    prompt();
+}
+
+static void setup_main_menu(void){
+    GameMode = GM_Menu; // the menu starts on S_Main
+}
+
+static void setup_pause_menu(void){
+    GameMode = GM_Running;
+    open_menu(S_Pause);
+}
+
+static void setup_settings_menu(void){
+    open_settings_menu();
+}
+
+static void setup_highscore_menu(void){
+    static const char *names[] = {"ANA", "BOB", "CY", "DEE", "EVE"};
+    HighScore.count = array_size(HighScore.score);
+    for(i32 i = 0; i < HighScore.count; i++){
+        ScoreInfo *info = &HighScore.score[i];
+        set_zero(info, sizeof(*info));
+        snprintf(info->name, sizeof(info->name), "%s", names[i]);
+        info->score = 50000 - i * 7321;
+        info->date = (Date){.day = 1 + i * 5, .month = 1 + i * 2, .year = 2024};
+    }
+    open_menu(S_Highscore);
+}
+
+static void draw_menu(void){
+    menu();
+}
+
+static void draw_text_sample(void){
+    clear_screen(Vec4(0.1f, 0.1f, 0.1f, 0.0f));
+    set_layer(LAYER_TEXT);
+    char ascii[96];
+    for(i32 i = 0; i < 95; i++) ascii[i] = (char)(' ' + i);
+    ascii[95] = 0;
+
+    Font *fonts[] = {&BigFont, &DefaultFont, &DebugFont};
+    f32 y = 10.0f;
+    for(i32 i = 0; i < array_size(fonts); i++){
+        set_font(fonts[i]);
+        draw_text_warped(Rect(10.0f, y, WWIDTH - 20.0f, 4.0f * fonts[i]->line_height), White_v4, "%s", ascii);
+        y += 4.0f * fonts[i]->line_height;
+    }
+    set_font(&DefaultFont);
+    draw_centered_text(WWIDTH / 2.0f, y, Yellow_v4, "Score:%d Lines:%d", 123456, 78);
+    draw_text(10.0f, y + 30.0f, Vec4(1.0f, 0.3f, 0.3f, 0.5f), "translucent %.2f", 0.5f);
+}
+
+static void setup_grid(void){
+    start_game(0);
+    if(!os_read_file(&Game.sim.grid, sizeof(Game.sim.grid), Opt.grid_file)){
+        printf("can't read %s\n", Opt.grid_file);
+        exit(1);
+    }
+    restart_game(&Game, false);
+    Game.autoplay_used = true;
+}
+
+static void setup_replay(void){
+    i32 size;
+    u8 *data = os_read_whole_file(Opt.replay_file, &size);
+    if(!data || !replay_decode(&Game.playback, data, size)){
+        printf("can't read replay %s\n", Opt.replay_file);
+        exit(1);
+    }
+    start_game(0);
+    Game.playback_data = data;
+    replay_start_playback(&Game.playback, &Game.sim);
+    replay_begin(&Game.recording, &Game.sim, Game.recording_runs, Game.recording_capacity);
+    Game.replay_playing = true;
+    ReplayFrame = 0;
+}
+
+// Pixels further apart than the tolerance in any channel
+static i32 compare_pixels(const u32 *a, const u32 *b, i32 count, i32 *max_delta){
+    i32 bad = 0;
+    *max_delta = 0;
+    for(i32 i = 0; i < count; i++){
+        if(a[i] == b[i]) continue;
+        i32 delta = 0;
+        for(i32 c = 0; c < 4; c++)
+            delta = MAX(delta, abs((i32)((a[i] >> (c * 8)) & 0xff) - (i32)((b[i] >> (c * 8)) & 0xff)));
+        *max_delta = MAX(*max_delta, delta);
+        bad += delta > Opt.tolerance;
+    }
+    return bad;
+}
+
+static void check_frame(const char *name){
+    char golden_path[512], out_path[512];
+    snprintf(golden_path, sizeof(golden_path), "%s/%s.png", Opt.golden_dir, name);
+    snprintf(out_path, sizeof(out_path), "%s/%s.png", Opt.out_dir, name);
+    i32 pixel_count = Target.width * Target.height;
+
+    if(Opt.update){
+        b32 written = png_write(golden_path, Target.pixels, Target.width, Target.height);
+        printf("%s\n", written? "written" : "CAN'T WRITE");
+        Failures += !written;
+        return;
+    }
+
+    i32 w, h;
+    stbi_set_flip_vertically_on_load(false); // goldens are top down like the raster
+    u32 *golden = (u32*)stbi_load(golden_path, &w, &h, NULL, 4);
+    stbi_set_flip_vertically_on_load(true);
+    if(!golden || w != Target.width || h != Target.height){
+        printf("FAIL (%s)\n", golden? "size differs" : "no golden");
+        Failures++;
+        png_write(out_path, Target.pixels, Target.width, Target.height);
+        if(golden) stbi_image_free(golden);
+        return;
+    }
+
+    i32 max_delta;
+    i32 bad = compare_pixels(Target.pixels, golden, pixel_count, &max_delta);
+    stbi_image_free(golden);
+    if(bad > Opt.max_pixels){
+        printf("FAIL %d pixels differ, max delta %d, see %s\n", bad, max_delta, out_path);
+        Failures++;
+        png_write(out_path, Target.pixels, Target.width, Target.height);
+    } else{
+        printf("ok (max delta %d)\n", max_delta);
+    }
+}
+
+static void render(void (*draw)(void), f64 *record, f64 *raster){
+    memset(Target.pixels, 0, sizeof(u32) * Target.width * Target.height);
+    f64 t0 = wall_seconds();
+    draw();
+    f64 t1 = wall_seconds();
+    execute_draw_commands();
+    reset_frame_stats();
+    f64 t2 = wall_seconds();
+    *record = t1 - t0;
+    *raster = t2 - t1;
+}
+
+// Draws the frame repeats times for the timings, the pixels of the last
+// one are checked. Only the color is, the window doesn't show the alpha
+// the frame leaves behind.
+static void run_frame(const char *name, void (*draw)(void)){
+    f64 record_total = 0, raster_total = 0, worst = 0;
+    for(i32 i = 0; i < Opt.repeats; i++){
+        f64 record, raster;
+        render(draw, &record, &raster);
+        record_total += record;
+        raster_total += raster;
+        worst = MAX(worst, record + raster);
+    }
+    for(i32 i = 0; i < Target.width * Target.height; i++)
+        Target.pixels[i] |= 0xff000000;
+    printf("%-16s %9.3f %9.3f %9.3f   ", name, record_total / Opt.repeats * 1e3, raster_total / Opt.repeats * 1e3, worst * 1e3);
+    check_frame(name);
+}
+
+static void usage(void){
+    printf("usage: golden_frames [-u] [-d dir] [-o dir] [-t tolerance] [-p pixels] [-n repeats]\n"
+           "                     [-j threads] [-g grid.dat] [-r replay.rpl -f frame[,frame...]]\n");
+}
+
+static b32 parse_frames(const char *list){
+    while(*list){
+        if(Opt.replay_frame_count >= MAX_REPLAY_FRAMES) return false;
+        char *end;
+        long frame = strtol(list, &end, 10);
+        if(end == list || frame < 0) return false;
+        Opt.replay_frames[Opt.replay_frame_count++] = (i32)frame;
+        list = *end == ','? end + 1 : end;
+    }
+    return true;
+}
+
+int main(int argc, char **argv){
+    Opt.threads = job_cpu_count();
+    for(i32 i = 1; i < argc; i++){
+        const char *arg = argv[i];
+        if(strcmp(arg, "-u") == 0){
+            Opt.update = true;
+            continue;
+        }
+        const char *value = i + 1 < argc? argv[i + 1] : NULL;
+        if(!value || arg[0] != '-' || strlen(arg) != 2){
+            usage();
+            return 1;
+        }
+        switch(arg[1]){
+            case 'd': Opt.golden_dir = value; break;
+            case 'o': Opt.out_dir = value; break;
+            case 't': Opt.tolerance = atoi(value); break;
+            case 'p': Opt.max_pixels = atoi(value); break;
+            case 'n': Opt.repeats = MAX(atoi(value), 1); break;
+            case 'j': Opt.threads = atoi(value); break;
+            case 'g': Opt.grid_file = value; break;
+            case 'r': Opt.replay_file = value; break;
+            case 'f':
+                if(!parse_frames(value)){
+                    usage();
+                    return 1;
+                }
+                break;
+            default: usage(); return 1;
+        }
+        i++;
+    }
+    Opt.threads = MAX(1, MIN(Opt.threads, JOB_MAX_WORKERS));
+    if(Opt.replay_file && !Opt.replay_frame_count){
+        printf("-r needs the frames to check, -f\n");
+        return 1;
+    }
+    mkdir(Opt.update? Opt.golden_dir : Opt.out_dir, 0755);
+
+    static JobPool pool;
+    job_pool_init(&pool, Opt.threads);
+    if(!raster_init(&Target, WWIDTH, WHEIGHT, &pool)){
+        printf("Out of memory\n");
+        return 1;
+    }
+    engine_setup(raster_backend_create(&Target));
+    TimeElapsed = 0;
+
+    // In order, each setup starts from the state the one before left
+    static const Scene scenes[] = {
+        {"game",          setup_game,           draw_game},
+        {"game_pause",    setup_pause,          draw_game},
+        {"prompt",        setup_prompt,         draw_prompt},
+        {"menu_main",     setup_main_menu,      draw_menu},
+        {"menu_pause",    setup_pause_menu,     draw_menu},
+        {"menu_settings", setup_settings_menu,  draw_menu},
+        {"menu_scores",   setup_highscore_menu, draw_menu},
+        {"text",          NULL,                 draw_text_sample},
+    };
+
+    printf("%dx%d, %d threads, %d repeats\n", Target.width, Target.height, Opt.threads, Opt.repeats);
+    printf("frame            record ms raster ms  worst ms   result\n");
+    for(i32 i = 0; i < array_size(scenes); i++){
+        if(scenes[i].setup) scenes[i].setup();
+        run_frame(scenes[i].name, scenes[i].draw);
+    }
+
+    if(Opt.grid_file){
+        setup_grid();
+        run_frame("grid", draw_game);
+    }
+
+    if(Opt.replay_file){
+        setup_replay();
+        for(i32 i = 0; i < Opt.replay_frame_count; i++){
+            i32 frame = Opt.replay_frames[i];
+            if(frame < ReplayFrame){
+                setup_replay(); // frames out of order, play again from the start
+            }
+            play_frames(frame - ReplayFrame, NULL);
+            ReplayFrame = frame;
+            char name[32];
+            snprintf(name, sizeof(name), "replay_%d", frame);
+            run_frame(name, draw_game);
+        }
+    }
+
+    job_pool_shutdown(&pool);
+    if(Failures) printf("%d frame%s failed\n", Failures, Failures == 1? "" : "s");
+    return Failures? 1 : 0;
+}
@@ -0,0 +1,130 @@
+// Platform layer without a window, audio or gpu, for the tools that run
+// the game code on Linux (bench_render). Same os_* functions as
+// windows.c on top of stdio. The render backend is up to the tool.
+
+#include "engine.h"
+
+#include <string.h>
+#include <time.h>
+
+void *os_open_file(const char *name){
+    return fopen(name, "rb");
+}
+
+b32 os_close_file(void *file){
+    return fclose((FILE*)file) == 0;
+}
+
+u8* os_read_whole_file_handle(void *file_handle, i32 *bytes){
+    FILE *file = (FILE*)file_handle;
+    *bytes = 0;
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(file_size < 0) return NULL;
+
+    u8 *buffer = os_memory_alloc(file_size);
+    if(!buffer) return NULL;
+    if(fread(buffer, 1, file_size, file) != (size_t)file_size){
+        os_memory_free(buffer);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_SET);
+    *bytes = (i32)file_size;
+    return buffer;
+}
+
+u8* os_read_whole_file(const char *name, i32 *bytes){
+    *bytes = 0;
+    FILE *file = fopen(name, "rb");
+    if(!file) return NULL;
+    u8 *buffer = os_read_whole_file_handle(file, bytes);
+    fclose(file);
+    return buffer;
+}
+
+b32 os_write_to_file(void *data, i32 bytes, const char *name){
+    FILE *file = fopen(name, "wb");
+    if(!file) return false;
+    size_t written = fwrite(data, 1, bytes, file);
+    return (fclose(file) == 0) & (written == (size_t)bytes);
+}
+
+b32 os_read_file(void *buffer, i32 bytes, const char *name){
+    FILE *file = fopen(name, "rb");
+    if(!file) return false;
+    size_t read = fread(buffer, 1, bytes, file);
+    fclose(file);
+    return read == (size_t)bytes;
+}
+
+// The game asks for Windows fonts, these are the closest ones that come
+// with most distributions
+char* os_font_path(char *buffer, u32 size, const char *font_name){
+    static const struct{ const char *windows, *substitute; }substitutes[] = {
+        {"Arial.ttf",   "DejaVuSans.ttf"},
+        {"Consola.ttf", "DejaVuSansMono.ttf"},
+    };
+    static const char *font_dirs[] = {
+        "/usr/share/fonts/truetype/dejavu/",
+        "/usr/share/fonts/dejavu/",
+        "/usr/share/fonts/TTF/",
+    };
+
+    const char *name = font_name;
+    for(i32 i = 0; i < array_size(substitutes); i++){
+        if(strcmp(font_name, substitutes[i].windows) == 0)
+            name = substitutes[i].substitute;
+    }
+    for(i32 i = 0; i < array_size(font_dirs); i++){
+        snprintf(buffer, size, "%s%s", font_dirs[i], name);
+        FILE *file = fopen(buffer, "rb");
+        if(file){
+            fclose(file);
+            return buffer;
+        }
+    }
+    printf("font %s not found\n", font_name);
+    assert(false);
+    return buffer;
+}
+
+Date os_get_local_time(void){
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    Date date = {
+        .day   = local.tm_mday,
+        .month = local.tm_mon + 1,
+        .year  = local.tm_year + 1900,
+    };
+    return date;
+}
+
+// Zeroed like VirtualAlloc
+void *os_memory_alloc(size_t bytes){
+    return calloc(1, bytes);
+}
+
+b32 os_memory_free(void *address){
+    free(address);
+    return true;
+}
+
+// No audio device, sounds are empty and playing them does nothing
+
+Sound load_wave_file(const char *file_name){
+    (void)file_name;
+    return (Sound){0};
+}
+
+void play_sound(Sound sound, f32 volume, b32 in_loop){
+    (void)sound; (void)volume; (void)in_loop;
+}
+
+f32 sound_length(Sound sound){
+    (void)sound;
+    return 0.0f;
+}
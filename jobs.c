@@ -0,0 +1,213 @@
+#include "basic.h"
+#include "jobs.h"
+#include "profiler.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+
+static inline i32 atomic_add(volatile i32 *value, i32 add){
+    return InterlockedExchangeAdd((volatile LONG *)value, add) + add;
+}
+static inline b32 atomic_cas(volatile i32 *value, i32 expected, i32 desired){
+    return InterlockedCompareExchange((volatile LONG *)value, desired, expected) == expected;
+}
+static inline i32 atomic_load(volatile i32 *value){
+    return InterlockedCompareExchange((volatile LONG *)value, 0, 0);
+}
+static inline void thread_yield(void){ SwitchToThread(); }
+
+static void semaphore_init(JobSemaphore *s){ *s = CreateSemaphoreA(NULL, 0, MAXi32, NULL); }
+static void semaphore_free(JobSemaphore *s){ CloseHandle(*s); }
+static void semaphore_post(JobSemaphore *s, i32 count){ ReleaseSemaphore(*s, count, NULL); }
+static void semaphore_wait(JobSemaphore *s){ WaitForSingleObject(*s, INFINITE); }
+
+static DWORD WINAPI worker_thread(LPVOID param);
+static void thread_start(struct JobWorker *worker){
+    worker->thread = CreateThread(NULL, 0, worker_thread, worker, 0, NULL);
+    assert(worker->thread);
+}
+static void thread_join(struct JobWorker *worker){
+    WaitForSingleObject(worker->thread, INFINITE);
+    CloseHandle(worker->thread);
+}
+
+i32 job_cpu_count(void){
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (i32)info.dwNumberOfProcessors;
+}
+#else
+#include <sched.h>
+#include <unistd.h>
+
+static inline i32 atomic_add(volatile i32 *value, i32 add){
+    return __atomic_add_fetch(value, add, __ATOMIC_SEQ_CST);
+}
+static inline b32 atomic_cas(volatile i32 *value, i32 expected, i32 desired){
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline i32 atomic_load(volatile i32 *value){
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+static inline void thread_yield(void){ sched_yield(); }
+
+static void semaphore_init(JobSemaphore *s){ sem_init(s, 0, 0); }
+static void semaphore_free(JobSemaphore *s){ sem_destroy(s); }
+static void semaphore_post(JobSemaphore *s, i32 count){ while(count--) sem_post(s); }
+static void semaphore_wait(JobSemaphore *s){ while(sem_wait(s) != 0); }
+
+static void *worker_thread(void *param);
+static void thread_start(struct JobWorker *worker){
+    i32 result = pthread_create(&worker->thread, NULL, worker_thread, worker);
+    assert(result == 0);
+}
+static void thread_join(struct JobWorker *worker){
+    pthread_join(worker->thread, NULL);
+}
+
+i32 job_cpu_count(void){
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0? (i32)count : 1;
+}
+#endif
+
+// Queues are only touched for a few instructions at a time, a spin lock is enough
+static inline void queue_lock(JobQueue *queue){
+    while(!atomic_cas(&queue->lock, 0, 1))
+        thread_yield();
+}
+
+static inline void queue_unlock(JobQueue *queue){
+    atomic_cas(&queue->lock, 1, 0);
+}
+
+static b32 queue_pop(JobQueue *queue, Job *job){
+    b32 result = false;
+    queue_lock(queue);
+    if(queue->bottom != queue->top){
+        *job = queue->jobs[--queue->bottom & (JOB_QUEUE_SIZE - 1)];
+        result = true;
+    }
+    queue_unlock(queue);
+    return result;
+}
+
+static b32 queue_steal(JobQueue *queue, Job *job){
+    b32 result = false;
+    queue_lock(queue);
+    if(queue->bottom != queue->top){
+        *job = queue->jobs[queue->top++ & (JOB_QUEUE_SIZE - 1)];
+        result = true;
+    }
+    queue_unlock(queue);
+    return result;
+}
+
+// Own jobs first, newest first so they are still warm, then steal the
+// oldest job of the next worker that has one
+static b32 find_job(JobPool *pool, i32 worker, Job *job){
+    if(queue_pop(&pool->queues[worker], job)) return true;
+    for(i32 i = 1; i < pool->worker_count; i++){
+        i32 victim = (worker + i) % pool->worker_count;
+        if(queue_steal(&pool->queues[victim], job)) return true;
+    }
+    return false;
+}
+
+// Takes one sleeper off the count, whoever does that owes wake a post
+static b32 claim_sleeper(JobPool *pool){
+    for(;;){
+        i32 sleeping = atomic_load(&pool->sleeping);
+        if(sleeping <= 0) return false;
+        if(atomic_cas(&pool->sleeping, sleeping, sleeping - 1)) return true;
+    }
+}
+
+static void run_job(JobPool *pool, i32 worker, Job job){
+    PROFILE_BEGIN("job");
+    job.proc(pool, worker, job.data);
+    PROFILE_END();
+    atomic_add(&pool->pending, -1);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker_thread(LPVOID param){
+#else
+static void *worker_thread(void *param){
+#endif
+    struct JobWorker *self = param;
+    JobPool *pool = self->pool;
+    char name[PROFILER_NAME_SIZE];
+    snprintf(name, sizeof(name), "job worker %d", self->index);
+    profiler_thread_name(name);
+    while(atomic_load(&pool->running)){
+        Job job;
+        if(find_job(pool, self->index, &job)){
+            run_job(pool, self->index, job);
+            continue;
+        }
+        // Announce the sleep before the last look, a push after that
+        // either leaves a job to find or sees the sleeper and posts.
+        // Posts only go out for claimed sleepers so they don't pile up.
+        atomic_add(&pool->sleeping, 1);
+        if(find_job(pool, self->index, &job)){
+            if(!claim_sleeper(pool))
+                semaphore_wait(&pool->wake); // a push claimed us first, take its post
+            run_job(pool, self->index, job);
+        } else{
+            semaphore_wait(&pool->wake);
+        }
+    }
+    return 0;
+}
+
+void job_pool_init(JobPool *pool, i32 worker_count){
+    set_zero(pool, sizeof(*pool));
+    pool->worker_count = MAX(1, MIN(worker_count, JOB_MAX_WORKERS));
+    pool->running = true;
+    semaphore_init(&pool->wake);
+
+    for(i32 i = 0; i < pool->worker_count; i++){
+        pool->workers[i].pool  = pool;
+        pool->workers[i].index = i;
+        if(i) thread_start(&pool->workers[i]);
+    }
+}
+
+void job_pool_shutdown(JobPool *pool){
+    job_pool_wait(pool, 0);
+    atomic_cas(&pool->running, true, false);
+    semaphore_post(&pool->wake, pool->worker_count);
+    for(i32 i = 1; i < pool->worker_count; i++)
+        thread_join(&pool->workers[i]);
+    semaphore_free(&pool->wake);
+}
+
+// Jobs can push more jobs with the worker index they were given
+void job_push(JobPool *pool, i32 worker, JobProc *proc, void *data){
+    Job job = {.proc = proc, .data = data};
+    JobQueue *queue = &pool->queues[worker];
+    atomic_add(&pool->pending, 1);
+
+    queue_lock(queue);
+    b32 full = queue->bottom - queue->top >= JOB_QUEUE_SIZE;
+    if(!full)
+        queue->jobs[queue->bottom++ & (JOB_QUEUE_SIZE - 1)] = job;
+    queue_unlock(queue);
+
+    if(full)
+        run_job(pool, worker, job);
+    else if(pool->worker_count > 1 && claim_sleeper(pool))
+        semaphore_post(&pool->wake, 1);
+}
+
+// Runs jobs on the calling worker until every pushed job has finished
+void job_pool_wait(JobPool *pool, i32 worker){
+    while(atomic_load(&pool->pending) > 0){
+        Job job;
+        if(find_job(pool, worker, &job))
+            run_job(pool, worker, job);
+        else
+            thread_yield();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Small work stealing job pool. Every worker owns a deque, it pushes and
+// pops its own jobs at the bottom while idle workers steal from the top of
+// the others. The thread that owns the pool is worker 0 and helps out
+// while it waits, so a pool of N workers starts N - 1 threads.
+
+#include "basic.h"
+
+#if defined(_WIN32)
+typedef void *JobThread;
+typedef void *JobSemaphore;
+#else
+#include <pthread.h>
+#include <semaphore.h>
+typedef pthread_t JobThread;
+typedef sem_t JobSemaphore;
+#endif
+
+#define JOB_MAX_WORKERS 64
+#define JOB_QUEUE_SIZE  256 // power of two
+
+struct JobPool;
+typedef void JobProc(struct JobPool *pool, i32 worker, void *data);
+
+typedef struct{
+    JobProc *proc;
+    void *data;
+}Job;
+
+typedef struct{
+    volatile i32 lock;
+    i32 top;    // next job a thief takes
+    i32 bottom; // next free slot for the owner
+    Job jobs[JOB_QUEUE_SIZE];
+}JobQueue;
+
+typedef struct JobPool{
+    i32 worker_count;
+    volatile i32 pending; // pushed and not finished yet
+    volatile i32 running;
+    volatile i32 sleeping; // workers about to wait on wake that no push has claimed yet
+    JobSemaphore wake;
+
+    struct JobWorker{
+        struct JobPool *pool;
+        i32 index;
+        JobThread thread;
+    }workers[JOB_MAX_WORKERS];
+
+    JobQueue queues[JOB_MAX_WORKERS];
+}JobPool;
+
+i32 job_cpu_count(void);
+void job_pool_init(JobPool *pool, i32 worker_count);
+void job_pool_shutdown(JobPool *pool);
+void job_push(JobPool *pool, i32 worker, JobProc *proc, void *data);
+void job_pool_wait(JobPool *pool, i32 worker);
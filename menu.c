@@ -118,7 +118,7 @@ void init_highscore_menu_in_insert_mode(i32 board_position){
     const char start_name[] = "_";
     state->insert_mode_on = true;
     state->insert_board_index = board_position - 1;
-    strcpy_s(state->new_name.buffer, array_size(state->new_name.buffer), start_name);
+    snprintf(state->new_name.buffer, array_size(state->new_name.buffer), "%s", start_name);
     open_menu(S_Highscore);
 }
 
@@ -143,12 +143,12 @@ static void highscore_menu(void){
         if(key_pressed(get_key(Controls.confirme)) && state->insert_mode_on){
             if(strcmp(state->new_name.buffer, "_") != 0){
                 ScoreInfo *info = &HighScore.score[state->insert_board_index];
-                strcpy_s(info->name, array_size(info->name), state->new_name.buffer);
+                snprintf(info->name, array_size(info->name), "%.*s", (i32)array_size(info->name) - 1, state->new_name.buffer);
                 save_data_to_disk();
                 state->insert_mode_on = false;
                 set_zero(&state->new_name, sizeof(state->new_name));
                 close_menu();
-                restart_game(true);
+                restart_game(&Game, true);
             }
         }
 
@@ -310,6 +310,7 @@ static void settings_menu(void){
 
 void menu(void){
     clear_screen(Vec4(0.1f, 0.1f, 0.1f, 0.0f));
+    set_layer(LAYER_TEXT);
 
     set_font(&BigFont);
     switch(MenuScreen){
@@ -0,0 +1,108 @@
+#include "basic.h"
+#include "simulation.h"
+#include "placement.h"
+
+static inline u16 placement_state(i32 x, i32 y, i32 rotation){
+    return (u16)(((rotation * PLACEMENT_Y_RANGE) + (y + PLACEMENT_Y_OFFSET)) * PLACEMENT_X_RANGE + (x + PLACEMENT_X_OFFSET));
+}
+
+static inline b32 state_in_range(i32 x, i32 y){
+    return (u32)(x + PLACEMENT_X_OFFSET) < PLACEMENT_X_RANGE && (u32)(y + PLACEMENT_Y_OFFSET) < PLACEMENT_Y_RANGE;
+}
+
+static u64 piece_footprint(i32 x, i32 y, Piece piece){
+    const PieceShape *shape = piece_shape(piece);
+    u64 footprint = (u64)(y + shape->box.y + PLACEMENT_Y_OFFSET) << 40;
+    for(i32 i = 0; i < shape->box.h; i++){
+        u64 row = ((u32)shape->rows[shape->box.y + i] << (x + GridPad)) >> GridPad;
+        footprint |= row << (i * GridW);
+    }
+    return footprint;
+}
+
+static void add_placement(PlacementSearch *search, i32 x, i32 y, Piece piece, u16 state){
+    // O and the symmetric orientations of I, S and Z lock the same cells
+    // from different states, keep the first one found, it has the shortest path
+    u64 footprint = piece_footprint(x, y, piece);
+    for(i32 i = 0; i < search->count; i++){
+        if(search->placements[i].footprint == footprint)
+            return;
+    }
+
+    if(search->count >= PLACEMENT_MAX) return;
+    Placement *p = &search->placements[search->count++];
+    p->x = (i8)x;
+    p->y = (i8)y;
+    p->piece = piece;
+    p->state = state;
+    p->footprint = footprint;
+}
+
+// Returns how many distinct lock positions were found
+i32 find_placements(PlacementSearch *search, const Board *board, Piece piece, i32 x, i32 y){
+    set_zero(search->visited, sizeof(search->visited));
+    search->count = 0;
+
+    if(!state_in_range(x, y) || board_piece_collided(board, x, y, piece))
+        return 0;
+
+    const u8 moves[] = {SIM_INPUT_LEFT, SIM_INPUT_RIGHT, SIM_INPUT_ROTATE_LEFT, SIM_INPUT_ROTATE_RIGHT, SIM_INPUT_DOWN};
+
+    i32 head = 0;
+    i32 tail = 0;
+    u16 start = placement_state(x, y, piece.rotation);
+    search->visited[start / 64] |= 1ull << (start % 64);
+    search->parent[start] = start;
+    search->move[start] = 0;
+    search->queue[tail++] = start;
+
+    while(head < tail){
+        u16 current = search->queue[head++];
+        i32 c_x = current % PLACEMENT_X_RANGE - PLACEMENT_X_OFFSET;
+        i32 c_y = (current / PLACEMENT_X_RANGE) % PLACEMENT_Y_RANGE - PLACEMENT_Y_OFFSET;
+        Piece c_piece = {.type = piece.type, .rotation = (u8)(current / (PLACEMENT_X_RANGE * PLACEMENT_Y_RANGE))};
+
+        for(i32 m = 0; m < array_size(moves); m++){
+            i32 n_x = c_x;
+            i32 n_y = c_y;
+            Piece n_piece = c_piece;
+            switch(moves[m]){
+                case SIM_INPUT_LEFT:         n_x--; break;
+                case SIM_INPUT_RIGHT:        n_x++; break;
+                case SIM_INPUT_ROTATE_LEFT:  n_piece = rotate_piece(c_piece, -1); break;
+                case SIM_INPUT_ROTATE_RIGHT: n_piece = rotate_piece(c_piece, 1); break;
+                case SIM_INPUT_DOWN:         n_y++; break;
+            }
+
+            if(!state_in_range(n_x, n_y) || board_piece_collided(board, n_x, n_y, n_piece)){
+                if(moves[m] == SIM_INPUT_DOWN)
+                    add_placement(search, c_x, c_y, c_piece, current);
+                continue;
+            }
+
+            u16 next = placement_state(n_x, n_y, n_piece.rotation);
+            u64 bit = 1ull << (next % 64);
+            if(search->visited[next / 64] & bit) continue;
+            search->visited[next / 64] |= bit;
+            search->parent[next] = current;
+            search->move[next] = moves[m];
+            search->queue[tail++] = next;
+        }
+    }
+
+    return search->count;
+}
+
+// Writes the moves from the start state to the lock state and returns
+// their count, which may be more than capacity (nothing is written then)
+i32 placement_path(const PlacementSearch *search, const Placement *placement, u8 *moves, i32 capacity){
+    i32 length = 0;
+    for(u16 s = placement->state; search->parent[s] != s; s = search->parent[s])
+        length++;
+    if(length > capacity) return length;
+
+    i32 i = length;
+    for(u16 s = placement->state; search->parent[s] != s; s = search->parent[s])
+        moves[--i] = search->move[s];
+    return length;
+}
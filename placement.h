@@ -0,0 +1,37 @@
+#pragma once
+
+// Finds every position the active piece can lock in with a breadth first
+// search over (x, y, rotation), using the same moves and collision as the
+// simulation. Gravity timing is ignored, anything the moves can reach is
+// considered reachable. No allocation, all the scratch lives in the
+// caller's PlacementSearch.
+
+#include "basic.h"
+#include "simulation.h"
+
+#define PLACEMENT_X_OFFSET 3
+#define PLACEMENT_Y_OFFSET 4
+#define PLACEMENT_X_RANGE  16
+#define PLACEMENT_Y_RANGE  32
+#define PLACEMENT_STATES   (4 * PLACEMENT_X_RANGE * PLACEMENT_Y_RANGE)
+#define PLACEMENT_MAX      256
+
+typedef struct{
+    i8 x, y;
+    Piece piece;
+    u16 state;     // search state the piece locks from, see placement_path
+    u64 footprint; // filled cells, equal for placements that lock the same cells
+}Placement;
+
+typedef struct{
+    u64 visited[PLACEMENT_STATES / 64];
+    u16 parent[PLACEMENT_STATES];
+    u8 move[PLACEMENT_STATES]; // SIM_INPUT_* bit that reached the state
+    u16 queue[PLACEMENT_STATES];
+
+    i32 count;
+    Placement placements[PLACEMENT_MAX];
+}PlacementSearch;
+
+i32 find_placements(PlacementSearch *search, const Board *board, Piece piece, i32 x, i32 y);
+i32 placement_path(const PlacementSearch *search, const Placement *placement, u8 *moves, i32 capacity);
@@ -0,0 +1,263 @@
+#include "png_writer.h"
+
+#include <string.h>
+
+#define LZ_WINDOW     32768
+#define LZ_HASH_BITS  15
+#define LZ_MIN_MATCH  3
+#define LZ_MAX_MATCH  258
+#define LZ_MAX_CHAIN  32 // candidates tried per position
+
+typedef struct{
+    u8 *data;
+    size_t size, capacity;
+    u64 bits;
+    i32 bit_count;
+}ByteStream;
+
+static void stream_reserve(ByteStream *stream, size_t extra){
+    if(stream->size + extra <= stream->capacity) return;
+    size_t capacity = MAX(stream->capacity * 2, stream->size + extra);
+    stream->data = realloc(stream->data, capacity);
+    assert(stream->data);
+    stream->capacity = capacity;
+}
+
+static void put_byte(ByteStream *stream, u8 byte){
+    stream_reserve(stream, 1);
+    stream->data[stream->size++] = byte;
+}
+
+static void put_u32_be(ByteStream *stream, u32 v){
+    put_byte(stream, (u8)(v >> 24));
+    put_byte(stream, (u8)(v >> 16));
+    put_byte(stream, (u8)(v >> 8));
+    put_byte(stream, (u8)v);
+}
+
+// Deflate packs bits from the least significant end
+static void put_bits(ByteStream *stream, u32 value, i32 count){
+    stream->bits |= (u64)value << stream->bit_count;
+    stream->bit_count += count;
+    while(stream->bit_count >= 8){
+        put_byte(stream, (u8)stream->bits);
+        stream->bits >>= 8;
+        stream->bit_count -= 8;
+    }
+}
+
+static void flush_bits(ByteStream *stream){
+    if(stream->bit_count > 0) put_byte(stream, (u8)stream->bits);
+    stream->bits = 0;
+    stream->bit_count = 0;
+}
+
+// Huffman codes go most significant bit first
+static void put_code(ByteStream *stream, u32 code, i32 length){
+    u32 reversed = 0;
+    for(i32 i = 0; i < length; i++)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    put_bits(stream, reversed, length);
+}
+
+// Fixed literal/length code, RFC 1951 3.2.6
+static void put_symbol(ByteStream *stream, i32 symbol){
+    if(symbol < 144)      put_code(stream, 0x30 + symbol, 8);
+    else if(symbol < 256) put_code(stream, 0x190 + symbol - 144, 9);
+    else if(symbol < 280) put_code(stream, symbol - 256, 7);
+    else                  put_code(stream, 0xc0 + symbol - 280, 8);
+}
+
+static const u16 LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const u8 LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const u16 DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const u8 DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static void put_match(ByteStream *stream, i32 length, i32 distance){
+    i32 l = 28;
+    while(LengthBase[l] > length) l--;
+    put_symbol(stream, 257 + l);
+    put_bits(stream, length - LengthBase[l], LengthExtra[l]);
+
+    i32 d = 29;
+    while(DistanceBase[d] > distance) d--;
+    put_code(stream, d, 5);
+    put_bits(stream, distance - DistanceBase[d], DistanceExtra[d]);
+}
+
+static inline u32 hash3(const u8 *p){
+    u32 v = (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// One final fixed Huffman block, greedy matches from hash chains
+static void deflate_fixed(ByteStream *stream, const u8 *data, i32 size){
+    i32 *head = malloc(sizeof(i32) << LZ_HASH_BITS);
+    i32 *prev = malloc(sizeof(i32) * LZ_WINDOW);
+    assert(head && prev);
+    memset(head, 0xff, sizeof(i32) << LZ_HASH_BITS);
+
+    put_bits(stream, 1, 1); // last block
+    put_bits(stream, 1, 2); // fixed codes
+
+    i32 at = 0;
+    while(at < size){
+        i32 best_length = 0, best_distance = 0;
+        if(at + LZ_MIN_MATCH <= size){
+            u32 h = hash3(data + at);
+            i32 max_length = MIN(LZ_MAX_MATCH, size - at);
+            i32 candidate = head[h];
+            for(i32 chain = 0; chain < LZ_MAX_CHAIN && candidate >= 0 && at - candidate <= LZ_WINDOW; chain++){
+                i32 length = 0;
+                while(length < max_length && data[candidate + length] == data[at + length]) length++;
+                if(length > best_length){
+                    best_length = length;
+                    best_distance = at - candidate;
+                    if(length == max_length) break;
+                }
+                candidate = prev[candidate % LZ_WINDOW];
+            }
+        }
+
+        i32 advance = best_length >= LZ_MIN_MATCH? best_length : 1;
+        if(advance > 1) put_match(stream, best_length, best_distance);
+        else            put_symbol(stream, data[at]);
+
+        for(i32 end = at + advance; at < end; at++){
+            if(at + LZ_MIN_MATCH > size) continue;
+            u32 h = hash3(data + at);
+            prev[at % LZ_WINDOW] = head[h];
+            head[h] = at;
+        }
+    }
+    put_symbol(stream, 256);
+    flush_bits(stream);
+
+    free(head);
+    free(prev);
+}
+
+static u32 crc32(u32 crc, const u8 *data, size_t size){
+    static u32 table[256];
+    if(!table[1]){
+        for(u32 i = 0; i < 256; i++){
+            u32 c = i;
+            for(i32 k = 0; k < 8; k++) c = c & 1? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static u32 adler32(const u8 *data, size_t size){
+    u32 a = 1, b = 0;
+    for(size_t i = 0; i < size; i++){
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void put_chunk(ByteStream *png, const char *type, const u8 *data, size_t size){
+    put_u32_be(png, (u32)size);
+    size_t start = png->size;
+    for(i32 i = 0; i < 4; i++) put_byte(png, (u8)type[i]);
+    stream_reserve(png, size);
+    if(size) memcpy(png->data + png->size, data, size);
+    png->size += size;
+    put_u32_be(png, crc32(0, png->data + start, png->size - start));
+}
+
+static inline u8 paeth(u8 a, u8 b, u8 c){
+    i32 p = a + b - c;
+    i32 pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if(pa <= pb && pa <= pc) return a;
+    return pb <= pc? b : c;
+}
+
+// Each row gets the filter with the smallest sum of absolute values, the
+// usual guess at what compresses best
+static void filter_rows(u8 *out, const u8 *pixels, i32 width, i32 height){
+    i32 stride = width * 4;
+    u8 *candidates = malloc((size_t)stride * 5);
+    assert(candidates);
+    for(i32 y = 0; y < height; y++){
+        const u8 *row = pixels + (size_t)y * stride;
+        const u8 *up  = y > 0? row - stride : NULL;
+        u32 best_score = ~0u;
+        i32 best = 0;
+        for(i32 filter = 0; filter < 5; filter++){
+            u8 *f = candidates + (size_t)filter * stride;
+            u32 score = 0;
+            for(i32 i = 0; i < stride; i++){
+                u8 a = i >= 4? row[i - 4] : 0;
+                u8 b = up? up[i] : 0;
+                u8 c = i >= 4 && up? up[i - 4] : 0;
+                u8 predict = 0;
+                switch(filter){
+                    case 1: predict = a; break;
+                    case 2: predict = b; break;
+                    case 3: predict = (u8)((a + b) / 2); break;
+                    case 4: predict = paeth(a, b, c); break;
+                }
+                f[i] = (u8)(row[i] - predict);
+                score += f[i] < 128? f[i] : 256 - f[i];
+            }
+            if(score < best_score){
+                best_score = score;
+                best = filter;
+            }
+        }
+        u8 *dst = out + (size_t)y * (stride + 1);
+        dst[0] = (u8)best;
+        memcpy(dst + 1, candidates + (size_t)best * stride, stride);
+    }
+    free(candidates);
+}
+
+b32 png_write(const char *path, const u32 *pixels, i32 width, i32 height){
+    size_t raw_size = (size_t)(width * 4 + 1) * height;
+    u8 *raw = malloc(raw_size);
+    assert(raw);
+    filter_rows(raw, (const u8*)pixels, width, height);
+
+    ByteStream zlib = {0};
+    put_byte(&zlib, 0x78); // deflate, 32K window
+    put_byte(&zlib, 0x01);
+    deflate_fixed(&zlib, raw, (i32)raw_size);
+    put_u32_be(&zlib, adler32(raw, raw_size));
+    free(raw);
+
+    ByteStream png = {0};
+    static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    for(i32 i = 0; i < 8; i++) put_byte(&png, signature[i]);
+    u8 header[13] = {
+        (u8)(width >> 24), (u8)(width >> 16), (u8)(width >> 8), (u8)width,
+        (u8)(height >> 24), (u8)(height >> 16), (u8)(height >> 8), (u8)height,
+        8, 6, 0, 0, 0, // 8 bit RGBA, deflate, no interlace
+    };
+    put_chunk(&png, "IHDR", header, sizeof(header));
+    put_chunk(&png, "IDAT", zlib.data, zlib.size);
+    put_chunk(&png, "IEND", NULL, 0);
+    free(zlib.data);
+
+    FILE *file = fopen(path, "wb");
+    b32 written = file && fwrite(png.data, 1, png.size, file) == png.size;
+    if(file) written &= fclose(file) == 0;
+    free(png.data);
+    return written;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Minimal PNG writer for the tools (golden_frames): RGBA8 only, one IDAT
+// compressed with fixed Huffman deflate and a greedy LZ77. Rendered frames
+// are mostly flat color, with the row filters they come out at a few
+// percent of their raw size. stb_image reads them back.
+
+#include "basic.h"
+
+// pixels are RGBA8, rows from the top
+b32 png_write(const char *path, const u32 *pixels, i32 width, i32 height);
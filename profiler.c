@@ -0,0 +1,152 @@
+#include "profiler.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+static inline i32 atomic_increment(volatile i32 *value){
+    return InterlockedIncrement((volatile LONG *)value);
+}
+static inline i32 atomic_read(volatile i32 *value){
+    return InterlockedCompareExchange((volatile LONG *)value, 0, 0);
+}
+static inline u32 ring_write_index(ProfilerRing *ring){
+    return ring->write; // volatile loads are acquire loads on msvc
+}
+static f64 wall_seconds(void){
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+}
+#else
+#include <time.h>
+
+static inline i32 atomic_increment(volatile i32 *value){
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+static inline i32 atomic_read(volatile i32 *value){
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+static inline u32 ring_write_index(ProfilerRing *ring){
+    return __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE);
+}
+static f64 wall_seconds(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (f64)t.tv_sec + (f64)t.tv_nsec * 1e-9;
+}
+#endif
+
+PROFILER_THREAD_LOCAL ProfilerRing *ProfilerThreadRing;
+
+static ProfilerRing *volatile Rings[PROFILER_MAX_THREADS];
+static volatile i32 RingCount;
+
+// rdtsc is converted to microseconds with the rate measured between the
+// first registered thread and the dump
+static volatile u64 StartTicks;
+static volatile f64 StartSeconds;
+
+// Threads past PROFILER_MAX_THREADS all share this one, the trace gets
+// garbled for them but nothing breaks
+static ProfilerRing OverflowRing;
+
+ProfilerRing *profiler_register_thread(void){
+    i32 index = atomic_increment(&RingCount) - 1;
+    ProfilerRing *ring = &OverflowRing;
+    if(index < PROFILER_MAX_THREADS){
+        ring = calloc(1, sizeof(ProfilerRing));
+        assert(ring);
+        snprintf(ring->name, sizeof(ring->name), "thread %d", index);
+        if(index == 0){
+            StartSeconds = wall_seconds();
+            StartTicks = __rdtsc();
+        }
+        Rings[index] = ring;
+    }
+    ProfilerThreadRing = ring;
+    return ring;
+}
+
+void profiler_thread_name(const char *name){
+    ProfilerRing *ring = ProfilerThreadRing;
+    if(!ring) ring = profiler_register_thread();
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+}
+
+static void write_json_string(FILE *file, const char *s){
+    fputc('"', file);
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\') fputc('\\', file);
+        if((u8)*s >= 0x20) fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+// Copies what the ring holds. The owner keeps writing while we read, so
+// anything it may have overwritten during the copy is dropped afterwards.
+static u32 copy_ring(ProfilerRing *ring, ProfilerEvent *events){
+    u32 end = ring_write_index(ring);
+    u32 count = MIN(end, PROFILER_RING_SIZE);
+    u32 start = end - count;
+    for(u32 i = 0; i < count; i++)
+        events[i] = ring->events[(start + i) & (PROFILER_RING_SIZE - 1)];
+
+    u32 now = ring_write_index(ring);
+    u32 overwritten = now - start > PROFILER_RING_SIZE? now - start - PROFILER_RING_SIZE : 0;
+    overwritten = MIN(overwritten, count);
+    memmove(events, events + overwritten, sizeof(ProfilerEvent) * (count - overwritten));
+    return count - overwritten;
+}
+
+b32 profiler_dump_trace(const char *path){
+    i32 ring_count = MIN(atomic_read(&RingCount), PROFILER_MAX_THREADS);
+    if(ring_count == 0) return false;
+    FILE *file = fopen(path, "wb");
+    if(!file) return false;
+
+    f64 seconds = wall_seconds() - StartSeconds;
+    u64 ticks = __rdtsc() - StartTicks;
+    f64 us_per_tick = seconds > 0.0 && ticks > 0? seconds * 1e6 / (f64)ticks : 0.0;
+
+    ProfilerEvent *events = malloc(sizeof(ProfilerEvent) * PROFILER_RING_SIZE);
+    assert(events);
+    const char *names[64]; // open zones, deeper ones are closed unnamed
+    b32 first = true;
+    fprintf(file, "{\"traceEvents\":[\n");
+    for(i32 r = 0; r < ring_count; r++){
+        ProfilerRing *ring = Rings[r];
+        if(!ring) continue; // registered but not stored yet
+        i32 tid = r + 1;
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first? "" : ",\n", tid);
+        write_json_string(file, ring->name);
+        fprintf(file, "}}");
+        first = false;
+
+        // The window can start inside zones whose begin was overwritten,
+        // their ends come first and are skipped
+        u32 count = copy_ring(ring, events);
+        i32 depth = 0;
+        for(u32 i = 0; i < count; i++){
+            ProfilerEvent *event = &events[i];
+            if(!event->name && depth == 0) continue;
+            f64 us = (f64)(i64)(event->time - StartTicks) * us_per_tick;
+            if(event->name){
+                if(depth < (i32)array_size(names)) names[depth] = event->name;
+                depth++;
+                fprintf(file, ",\n{\"ph\":\"B\",\"name\":");
+                write_json_string(file, event->name);
+            } else{
+                depth--;
+                fprintf(file, ",\n{\"ph\":\"E\",\"name\":");
+                write_json_string(file, depth < (i32)array_size(names)? names[depth] : "");
+            }
+            fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", tid, us);
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    free(events);
+    return fclose(file) == 0;
+}
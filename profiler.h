@@ -0,0 +1,63 @@
+#pragma once
+
+// Scoped cpu zones for finding frame spikes. PROFILE_BEGIN/PROFILE_END
+// pairs write a timestamped event into a ring owned by the calling thread
+// (no locks, two stores and an rdtsc), the oldest events are overwritten
+// so the rings always hold the last few seconds. profiler_dump_trace
+// writes what the rings hold as Chrome trace JSON, open it in
+// chrome://tracing or ui.perfetto.dev.
+//
+// Zone names are kept by pointer, use string literals. Build with
+// PROFILER_DISABLED to compile the zones out.
+
+#include "basic.h"
+
+#define PROFILER_RING_SIZE   (1 << 16) // events per thread, a power of two
+#define PROFILER_MAX_THREADS 64
+#define PROFILER_NAME_SIZE   32
+
+#if defined(_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#include <x86intrin.h>
+#endif
+
+typedef struct{
+    u64 time;         // __rdtsc
+    const char *name; // NULL ends the innermost zone
+}ProfilerEvent;
+
+typedef struct{
+    volatile u32 write; // events written so far, only the owner thread writes
+    char name[PROFILER_NAME_SIZE];
+    ProfilerEvent events[PROFILER_RING_SIZE];
+}ProfilerRing;
+
+extern PROFILER_THREAD_LOCAL ProfilerRing *ProfilerThreadRing;
+
+ProfilerRing *profiler_register_thread(void);
+void profiler_thread_name(const char *name);
+b32 profiler_dump_trace(const char *path);
+
+static inline void profiler_record(const char *name){
+    ProfilerRing *ring = ProfilerThreadRing;
+    if(!ring) ring = profiler_register_thread();
+    u32 index = ring->write;
+    ProfilerEvent *event = &ring->events[index & (PROFILER_RING_SIZE - 1)];
+    event->time = __rdtsc();
+    event->name = name;
+#if defined(_MSC_VER)
+    ring->write = index + 1; // volatile stores are release stores on msvc
+#else
+    __atomic_store_n(&ring->write, index + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+#if defined(PROFILER_DISABLED)
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#else
+#define PROFILE_BEGIN(name) profiler_record(name)
+#define PROFILE_END()       profiler_record(NULL)
+#endif
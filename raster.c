@@ -0,0 +1,601 @@
+#include "basic.h"
+#include "jobs.h"
+#include "raster.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RASTER_SSE2 1
+#endif
+
+#define SUBPIXEL_BITS 4 // vertex positions are snapped to 1/16 pixel
+#define SUBPIXEL      (1 << SUBPIXEL_BITS)
+#define GUARD_BAND    16384.0f // pixels, farther vertices are clamped
+
+enum RasterPrimitiveKinds{
+    PRIMITIVE_TRIANGLE,
+    PRIMITIVE_RECT, // unscaled sprite, texels map 1:1 to pixels
+};
+
+typedef struct RasterPrimitive{
+    i32 kind;
+    const RasterTexture *texture; // NULL when untextured
+    i32 x0, y0, x1, y1; // pixels it can cover, clipped to the target, max exclusive
+    b32 flat;  // same color on every vertex
+    u32 color; // when flat
+
+    // triangle: inside when a * x + b * y + c >= 0, x and y in subpixels
+    // at pixel centers, c has the fill rule bias in it
+    i64 a[3], b[3], c[3];
+    // triangle: base + dx * x + dy * y at pixel centers, uvs in texels
+    f32 planes[6][3]; // u, v, r, g, b, a
+
+    // rect: the unclipped top left pixel and the texel that goes there
+    i32 origin_x, origin_y;
+    i32 texel_x, texel_y; // texel_y goes down as y goes up
+}RasterPrimitive;
+
+typedef struct RasterBin{
+    Raster *raster;
+    i32 x0, y0, x1, y1; // the tile
+    i32 *primitives;
+    i32 count;
+    i32 capacity;
+}RasterBin;
+
+// What a batch's uniforms do to its vertices
+typedef struct{
+    f32 m[4][4]; // translation_matrix * ident_matrix
+    f32 scale_x, scale_y; // ndc to target pixels
+    const f32 (*uv)[3];
+    b32 uv_identity;
+    b32 pixel_exact; // moves whole pixels, no scaling, rects can be copied
+    i32 offset_x, offset_y;
+}BatchTransform;
+
+// ===================================================================
+// Pixels
+// ===================================================================
+
+// x / 255 rounded, exact for every product of two bytes
+static inline u32 div255(u32 x){
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline u32 modulate(u32 texel, u32 color){
+    u32 result = 0;
+    for(i32 shift = 0; shift < 32; shift += 8)
+        result |= div255(((texel >> shift) & 0xff) * ((color >> shift) & 0xff)) << shift;
+    return result;
+}
+
+// src alpha, one minus src alpha for color, the source alpha is kept
+static inline u32 blend(u32 dst, u32 src){
+    u32 a = src >> 24;
+    u32 result = src & 0xff000000;
+    for(i32 shift = 0; shift < 24; shift += 8)
+        result |= div255(((src >> shift) & 0xff) * a + ((dst >> shift) & 0xff) * (255 - a)) << shift;
+    return result;
+}
+
+static inline u32 pack_color(f32 r, f32 g, f32 b, f32 a){
+    u32 ur = (u32)(clampf(r, 0.0f, 255.0f) + 0.5f);
+    u32 ug = (u32)(clampf(g, 0.0f, 255.0f) + 0.5f);
+    u32 ub = (u32)(clampf(b, 0.0f, 255.0f) + 0.5f);
+    u32 ua = (u32)(clampf(a, 0.0f, 255.0f) + 0.5f);
+    return ur | (ug << 8) | (ub << 16) | (ua << 24);
+}
+
+static inline i32 wrap_texel(i32 i, i32 size){
+    if((size & (size - 1)) == 0) return i & (size - 1);
+    i %= size;
+    return i < 0? i + size : i;
+}
+
+static inline u32 fetch_texel(const RasterTexture *texture, f32 u, f32 v){
+    i32 x = wrap_texel((i32)floorf(u), texture->width);
+    i32 y = wrap_texel((i32)floorf(v), texture->height);
+    return texture->texels[y * texture->width + x];
+}
+
+#if RASTER_SSE2
+// Same math as the scalar versions, two pixels per register in 16 bit lanes
+
+static inline __m128i div255_epi16(__m128i x){
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static inline __m128i modulate4(__m128i texels, __m128i color){
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = div255_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(texels, zero), _mm_unpacklo_epi8(color, zero)));
+    __m128i hi = div255_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(texels, zero), _mm_unpackhi_epi8(color, zero)));
+    return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i blend_pair(__m128i dst, __m128i src){
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    return div255_epi16(_mm_add_epi16(_mm_mullo_epi16(src, a), _mm_mullo_epi16(dst, inv)));
+}
+
+static inline __m128i blend4(__m128i dst, __m128i src){
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = blend_pair(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi8(src, zero));
+    __m128i hi = blend_pair(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi8(src, zero));
+    __m128i alpha = _mm_set1_epi32((i32)0xff000000);
+    return _mm_or_si128(_mm_andnot_si128(alpha, _mm_packus_epi16(lo, hi)), _mm_and_si128(alpha, src));
+}
+
+static inline __m128i floor4(__m128 x){
+    __m128i t = _mm_cvttps_epi32(x);
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(t)))); // -1 where truncation went up
+}
+
+static inline __m128i pack_color4(__m128 r, __m128 g, __m128 b, __m128 a){
+    __m128 zero = _mm_setzero_ps(), max = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    __m128i ur = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(r, zero), max), half));
+    __m128i ug = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(g, zero), max), half));
+    __m128i ub = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(b, zero), max), half));
+    __m128i ua = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(a, zero), max), half));
+    return _mm_or_si128(_mm_or_si128(ur, _mm_slli_epi32(ug, 8)), _mm_or_si128(_mm_slli_epi32(ub, 16), _mm_slli_epi32(ua, 24)));
+}
+#endif
+
+// ===================================================================
+// Spans
+// ===================================================================
+
+static inline f32 plane_at(const f32 plane[3], f32 x, f32 y){
+    return plane[0] + plane[1] * x + plane[2] * y;
+}
+
+// Pixels [x0, x1) of row y
+static void fill_triangle_span(const RasterPrimitive *p, u32 *row, i32 y, i32 x0, i32 x1){
+    const RasterTexture *texture = p->texture;
+    f32 fy = (f32)y + 0.5f;
+    f32 u0 = p->planes[0][0] + p->planes[0][2] * fy, du = p->planes[0][1];
+    f32 v0 = p->planes[1][0] + p->planes[1][2] * fy, dv = p->planes[1][1];
+    i32 x = x0;
+
+#if RASTER_SSE2
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128i flat = _mm_set1_epi32((i32)p->color);
+    for(; x + 4 <= x1; x += 4){
+        __m128 fx = _mm_add_ps(_mm_set1_ps((f32)x + 0.5f), lanes);
+        __m128i color = flat;
+        if(!p->flat){
+            __m128 fyv = _mm_set1_ps(fy);
+            __m128 c[4];
+            for(i32 i = 0; i < 4; i++){
+                const f32 *plane = p->planes[2 + i];
+                c[i] = _mm_add_ps(_mm_add_ps(_mm_set1_ps(plane[0]), _mm_mul_ps(_mm_set1_ps(plane[1]), fx)), _mm_mul_ps(_mm_set1_ps(plane[2]), fyv));
+            }
+            color = pack_color4(c[0], c[1], c[2], c[3]);
+        }
+
+        __m128i src = color;
+        if(texture){
+            __m128i tx = floor4(_mm_add_ps(_mm_set1_ps(u0), _mm_mul_ps(_mm_set1_ps(du), fx)));
+            __m128i ty = floor4(_mm_add_ps(_mm_set1_ps(v0), _mm_mul_ps(_mm_set1_ps(dv), fx)));
+            i32 ix[4], iy[4];
+            u32 texels[4];
+            _mm_storeu_si128((__m128i *)ix, tx);
+            _mm_storeu_si128((__m128i *)iy, ty);
+            for(i32 i = 0; i < 4; i++){
+                i32 sx = wrap_texel(ix[i], texture->width);
+                i32 sy = wrap_texel(iy[i], texture->height);
+                texels[i] = texture->texels[sy * texture->width + sx];
+            }
+            src = modulate4(_mm_loadu_si128((const __m128i *)texels), color);
+        }
+        __m128i *dst = (__m128i *)(row + x);
+        _mm_storeu_si128(dst, blend4(_mm_loadu_si128(dst), src));
+    }
+#endif
+
+    for(; x < x1; x++){
+        f32 fx = (f32)x + 0.5f;
+        u32 color = p->color;
+        if(!p->flat){
+            color = pack_color(plane_at(p->planes[2], fx, fy), plane_at(p->planes[3], fx, fy),
+                               plane_at(p->planes[4], fx, fy), plane_at(p->planes[5], fx, fy));
+        }
+        u32 src = texture? modulate(fetch_texel(texture, u0 + du * fx, v0 + dv * fx), color) : color;
+        row[x] = blend(row[x], src);
+    }
+}
+
+static void fill_rect_span(const RasterPrimitive *p, u32 *row, i32 y, i32 x0, i32 x1){
+    const RasterTexture *texture = p->texture;
+    const u32 *texels = texture->texels + (size_t)(p->texel_y - (y - p->origin_y)) * texture->width;
+    i32 shift = p->texel_x - p->origin_x; // pixel x to texel x
+    b32 tinted = p->color != 0xffffffff;
+    i32 x = x0;
+
+#if RASTER_SSE2
+    const __m128i color = _mm_set1_epi32((i32)p->color);
+    for(; x + 4 <= x1; x += 4){
+        __m128i src = _mm_loadu_si128((const __m128i *)(texels + x + shift));
+        if(tinted) src = modulate4(src, color);
+        __m128i *dst = (__m128i *)(row + x);
+        _mm_storeu_si128(dst, blend4(_mm_loadu_si128(dst), src));
+    }
+#endif
+
+    for(; x < x1; x++){
+        u32 src = tinted? modulate(texels[x + shift], p->color) : texels[x + shift];
+        row[x] = blend(row[x], src);
+    }
+}
+
+static inline i64 floor_div(i64 a, i64 b){ // b > 0
+    i64 q = a / b;
+    return (a % b != 0 && a < 0)? q - 1 : q;
+}
+
+static inline i64 ceil_div(i64 a, i64 b){ // b > 0
+    i64 q = a / b;
+    return (a % b != 0 && a > 0)? q + 1 : q;
+}
+
+static void draw_primitive(const Raster *raster, const RasterPrimitive *p, const RasterBin *bin){
+    i32 x0 = MAX(p->x0, bin->x0), x1 = MIN(p->x1, bin->x1);
+    i32 y0 = MAX(p->y0, bin->y0), y1 = MIN(p->y1, bin->y1);
+    if(x0 >= x1 || y0 >= y1) return;
+
+    for(i32 y = y0; y < y1; y++){
+        u32 *row = raster->pixels + (size_t)y * raster->width;
+        if(p->kind == PRIMITIVE_RECT){
+            fill_rect_span(p, row, y, x0, x1);
+            continue;
+        }
+
+        // Solve every edge for the first and last pixel center inside
+        i64 first = x0, last = x1 - 1;
+        i64 center_y = (i64)y * SUBPIXEL + SUBPIXEL / 2;
+        for(i32 e = 0; e < 3; e++){
+            i64 a = p->a[e];
+            i64 k = p->b[e] * center_y + p->c[e] + a * (SUBPIXEL / 2);
+            if(a > 0)      first = MAX(first, ceil_div(-k, a * SUBPIXEL));
+            else if(a < 0) last  = MIN(last, floor_div(k, -a * SUBPIXEL));
+            else if(k < 0) first = last + 1;
+        }
+        if(first <= last) fill_triangle_span(p, row, y, (i32)first, (i32)last + 1);
+    }
+}
+
+// ===================================================================
+// Setup and binning
+// ===================================================================
+
+static RasterPrimitive *push_primitive(Raster *raster){
+    if(raster->primitive_count >= raster->primitive_capacity){
+        i32 capacity = MAX(1024, raster->primitive_capacity * 2);
+        RasterPrimitive *grown = realloc(raster->primitives, sizeof(*grown) * capacity);
+        assert(grown);
+        raster->primitives = grown;
+        raster->primitive_capacity = capacity;
+    }
+    return &raster->primitives[raster->primitive_count++];
+}
+
+static void bin_primitive(Raster *raster, i32 index){
+    const RasterPrimitive *p = &raster->primitives[index];
+    i32 tx0 = p->x0 / RASTER_TILE_SIZE, tx1 = (p->x1 - 1) / RASTER_TILE_SIZE;
+    i32 ty0 = p->y0 / RASTER_TILE_SIZE, ty1 = (p->y1 - 1) / RASTER_TILE_SIZE;
+    for(i32 ty = ty0; ty <= ty1; ty++){
+        for(i32 tx = tx0; tx <= tx1; tx++){
+            RasterBin *bin = &raster->bins[ty * raster->tiles_x + tx];
+            if(bin->count >= bin->capacity){
+                i32 capacity = MAX(256, bin->capacity * 2);
+                i32 *grown = realloc(bin->primitives, sizeof(*grown) * capacity);
+                assert(grown);
+                bin->primitives = grown;
+                bin->capacity = capacity;
+            }
+            bin->primitives[bin->count++] = index;
+        }
+    }
+}
+
+// Empty primitives are dropped, the rest get binned
+static void finish_primitive(Raster *raster, RasterPrimitive *p){
+    p->x0 = MAX(p->x0, 0);
+    p->y0 = MAX(p->y0, 0);
+    p->x1 = MIN(p->x1, raster->width);
+    p->y1 = MIN(p->y1, raster->height);
+    if(p->x0 >= p->x1 || p->y0 >= p->y1){
+        raster->primitive_count--;
+        return;
+    }
+    bin_primitive(raster, raster->primitive_count - 1);
+}
+
+static void set_batch_transform(const Raster *raster, const Uniforms *uniforms, BatchTransform *t){
+    for(i32 r = 0; r < 4; r++){
+        for(i32 c = 0; c < 4; c++){
+            f32 sum = 0;
+            for(i32 k = 0; k < 4; k++) sum += uniforms->translation_matrix[r][k] * uniforms->ident_matrix[k][c];
+            t->m[r][c] = sum;
+        }
+    }
+    t->scale_x = 0.5f * raster->width;
+    t->scale_y = 0.5f * raster->height;
+    t->uv = (const f32 (*)[3])uniforms->uv_matrix;
+    t->uv_identity = true;
+    for(i32 r = 0; r < 3; r++)
+        for(i32 c = 0; c < 3; c++)
+            t->uv_identity &= uniforms->uv_matrix[r][c] == (r == c? 1.0f : 0.0f);
+
+    // Where the unit vectors end up decides if sprites can be copied
+    const f32 (*m)[4] = (const f32 (*)[4])t->m;
+    f32 origin_x = (m[0][3] - m[0][2] + 1.0f) * t->scale_x;
+    f32 origin_y = (1.0f - (m[1][3] - m[1][2])) * t->scale_y;
+    b32 affine = m[3][0] == 0.0f && m[3][1] == 0.0f && m[3][3] - m[3][2] == 1.0f;
+    b32 unit = fabsf(m[0][0] * t->scale_x - 1.0f) < 1e-4f && fabsf(m[1][1] * t->scale_y + 1.0f) < 1e-4f &&
+               m[0][1] == 0.0f && m[1][0] == 0.0f;
+    t->offset_x = (i32)roundf(origin_x);
+    t->offset_y = (i32)roundf(origin_y);
+    t->pixel_exact = affine && unit && fabsf(origin_x - t->offset_x) < 1e-3f && fabsf(origin_y - t->offset_y) < 1e-3f;
+}
+
+// Vertex shader: pixels to clip space, then the viewport
+static inline void to_screen(const BatchTransform *t, f32 x, f32 y, f32 *sx, f32 *sy){
+    f32 cx = t->m[0][0] * x + t->m[0][1] * y - t->m[0][2] + t->m[0][3];
+    f32 cy = t->m[1][0] * x + t->m[1][1] * y - t->m[1][2] + t->m[1][3];
+    f32 cw = t->m[3][0] * x + t->m[3][1] * y - t->m[3][2] + t->m[3][3];
+    *sx = clampf((cx / cw + 1.0f) * t->scale_x, -GUARD_BAND, GUARD_BAND);
+    *sy = clampf((1.0f - cy / cw) * t->scale_y, -GUARD_BAND, GUARD_BAND);
+}
+
+static inline void transform_uv(const BatchTransform *t, f32 u, f32 v, f32 *tu, f32 *tv){
+    if(t->uv_identity){
+        *tu = u;
+        *tv = v;
+        return;
+    }
+    *tu = t->uv[0][0] * u + t->uv[0][1] * v + t->uv[0][2];
+    *tv = t->uv[1][0] * u + t->uv[1][1] * v + t->uv[1][2];
+}
+
+// Values at three screen points to a plane over pixel centers
+static void set_plane(f32 plane[3], const f32 x[3], const f32 y[3], const f32 value[3], f32 inv_det){
+    f32 d1 = value[1] - value[0], d2 = value[2] - value[0];
+    plane[1] = (d1 * (y[2] - y[0]) - d2 * (y[1] - y[0])) * inv_det;
+    plane[2] = (d2 * (x[1] - x[0]) - d1 * (x[2] - x[0])) * inv_det;
+    plane[0] = value[0] - plane[1] * x[0] - plane[2] * y[0];
+}
+
+// Screen positions, uvs after the uv matrix and RGBA8 colors
+static void setup_triangle(Raster *raster, const RasterTexture *texture, const f32 sx[3], const f32 sy[3],
+                           const f32 u[3], const f32 v[3], const u32 color[3]){
+    i64 X[3], Y[3];
+    for(i32 i = 0; i < 3; i++){
+        X[i] = (i64)roundf(sx[i] * SUBPIXEL);
+        Y[i] = (i64)roundf(sy[i] * SUBPIXEL);
+    }
+    i64 area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+    if(area == 0) return;
+    i32 order[3] = {0, 1, 2};
+    if(area < 0){ // no culling in GL either, flip it around
+        order[1] = 2;
+        order[2] = 1;
+    }
+
+    RasterPrimitive *p = push_primitive(raster);
+    p->kind = PRIMITIVE_TRIANGLE;
+    p->texture = texture;
+
+    f32 x[3], y[3];
+    i64 min_x = X[0], max_x = X[0], min_y = Y[0], max_y = Y[0];
+    for(i32 i = 0; i < 3; i++){
+        i32 from = order[i], to = order[(i + 1) % 3];
+        i64 a = Y[from] - Y[to];
+        i64 b = X[to] - X[from];
+        b32 top_left = a > 0 || (a == 0 && b > 0);
+        p->a[i] = a;
+        p->b[i] = b;
+        p->c[i] = -(a * X[from] + b * Y[from]) - (top_left? 0 : 1);
+
+        x[i] = (f32)X[i] / SUBPIXEL;
+        y[i] = (f32)Y[i] / SUBPIXEL;
+        min_x = MIN(min_x, X[i]); max_x = MAX(max_x, X[i]);
+        min_y = MIN(min_y, Y[i]); max_y = MAX(max_y, Y[i]);
+    }
+    p->x0 = (i32)floor_div(min_x, SUBPIXEL);
+    p->y0 = (i32)floor_div(min_y, SUBPIXEL);
+    p->x1 = (i32)floor_div(max_x, SUBPIXEL) + 1;
+    p->y1 = (i32)floor_div(max_y, SUBPIXEL) + 1;
+
+    f32 inv_det = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+    p->flat = color[0] == color[1] && color[1] == color[2];
+    p->color = color[0];
+    if(!p->flat){
+        for(i32 channel = 0; channel < 4; channel++){
+            f32 value[3];
+            for(i32 i = 0; i < 3; i++) value[i] = (f32)((color[i] >> (channel * 8)) & 0xff);
+            set_plane(p->planes[2 + channel], x, y, value, inv_det);
+        }
+    }
+    if(texture){
+        f32 tu[3], tv[3];
+        for(i32 i = 0; i < 3; i++){
+            tu[i] = u[i] * texture->width;
+            tv[i] = v[i] * texture->height;
+        }
+        set_plane(p->planes[0], x, y, tu, inv_det);
+        set_plane(p->planes[1], x, y, tv, inv_det);
+    }
+    finish_primitive(raster, p);
+}
+
+static void setup_triangles(Raster *raster, const RenderFrame *frame, const RenderBatch *batch, const BatchTransform *t){
+    const RasterTexture *texture = batch->textured? &raster->textures[batch->texture] : NULL;
+    for(i32 r = 0; r < batch->count; r++){
+        const VertexRange *range = &frame->ranges[batch->first + r];
+        assert(range->first + range->count <= frame->vertex_count);
+        for(i32 i = 0; i + 2 < range->count; i += 3){
+            f32 sx[3], sy[3], u[3], v[3];
+            u32 color[3];
+            for(i32 k = 0; k < 3; k++){
+                const Vertex *vertex = &frame->vertices[range->first + i + k];
+                to_screen(t, vertex->position[0], vertex->position[1], &sx[k], &sy[k]);
+                transform_uv(t, vertex->texture_coord[0] / 65535.0f, vertex->texture_coord[1] / 65535.0f, &u[k], &v[k]);
+                color[k] = vertex->color;
+            }
+            setup_triangle(raster, texture, sx, sy, u, v, color);
+        }
+    }
+}
+
+static void setup_sprites(Raster *raster, const RenderFrame *frame, const RenderBatch *batch, const BatchTransform *t){
+    const RasterTexture *texture = &raster->textures[batch->texture];
+    for(i32 i = 0; i < batch->count; i++){
+        const SpriteInstance *instance = &frame->instances[batch->first + i];
+        i32 px = instance->position[0], py = instance->position[1];
+        i32 ax = instance->atlas_rect[0], ay = instance->atlas_rect[1];
+        i32 w = instance->atlas_rect[2], h = instance->atlas_rect[3];
+        if(!w || !h) continue;
+
+        if(t->pixel_exact && t->uv_identity && ax + w <= texture->width && ay + h <= texture->height){
+            RasterPrimitive *p = push_primitive(raster);
+            p->kind = PRIMITIVE_RECT;
+            p->texture = texture;
+            p->flat = true;
+            p->color = instance->color;
+            p->origin_x = px + t->offset_x;
+            p->origin_y = py + t->offset_y;
+            p->texel_x = ax;
+            p->texel_y = texture->height - 1 - ay; // GL rows count from the bottom
+            p->x0 = p->origin_x;
+            p->y0 = p->origin_y;
+            p->x1 = p->origin_x + w;
+            p->y1 = p->origin_y + h;
+            finish_primitive(raster, p);
+            continue;
+        }
+
+        // What sprite.vert does with the unit quad
+        static const f32 corners[6][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 1}, {1, 0}, {0, 0}};
+        for(i32 tri = 0; tri < 2; tri++){
+            f32 sx[3], sy[3], u[3], v[3];
+            u32 color[3] = {instance->color, instance->color, instance->color};
+            for(i32 k = 0; k < 3; k++){
+                f32 ox = corners[tri * 3 + k][0] * w, oy = corners[tri * 3 + k][1] * h;
+                to_screen(t, px + ox, py + oy, &sx[k], &sy[k]);
+                f32 su = (ax + ox) / texture->width;
+                f32 sv = 1.0f - (ay + oy) / texture->height;
+                transform_uv(t, su, sv, &u[k], &v[k]);
+            }
+            setup_triangle(raster, texture, sx, sy, u, v, color);
+        }
+    }
+}
+
+static void draw_tile(JobPool *pool, i32 worker, void *data){
+    (void)pool; (void)worker;
+    RasterBin *bin = data;
+    Raster *raster = bin->raster;
+    const RenderFrame *frame = raster->frame;
+
+    if(frame->clear){
+        for(i32 y = bin->y0; y < bin->y1; y++){
+            u32 *row = raster->pixels + (size_t)y * raster->width;
+            for(i32 x = bin->x0; x < bin->x1; x++) row[x] = frame->clear_color;
+        }
+    }
+    for(i32 i = 0; i < bin->count; i++)
+        draw_primitive(raster, &raster->primitives[bin->primitives[i]], bin);
+}
+
+// ===================================================================
+// Api
+// ===================================================================
+
+b32 raster_init(Raster *raster, i32 width, i32 height, JobPool *pool){
+    set_zero(raster, sizeof(*raster));
+    raster->width  = width;
+    raster->height = height;
+    raster->pool   = pool;
+    raster->tiles_x = (width  + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    raster->tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    raster->pixels = calloc((size_t)width * height, sizeof(u32));
+    raster->bins   = calloc((size_t)raster->tiles_x * raster->tiles_y, sizeof(RasterBin));
+    if(!raster->pixels || !raster->bins){
+        raster_free(raster);
+        return false;
+    }
+
+    for(i32 ty = 0; ty < raster->tiles_y; ty++){
+        for(i32 tx = 0; tx < raster->tiles_x; tx++){
+            RasterBin *bin = &raster->bins[ty * raster->tiles_x + tx];
+            bin->raster = raster;
+            bin->x0 = tx * RASTER_TILE_SIZE;
+            bin->y0 = ty * RASTER_TILE_SIZE;
+            bin->x1 = MIN(width,  bin->x0 + RASTER_TILE_SIZE);
+            bin->y1 = MIN(height, bin->y0 + RASTER_TILE_SIZE);
+        }
+    }
+    return true;
+}
+
+void raster_free(Raster *raster){
+    if(raster->bins){
+        for(i32 i = 0; i < raster->tiles_x * raster->tiles_y; i++) free(raster->bins[i].primitives);
+    }
+    for(i32 i = 1; i <= raster->texture_count; i++) free(raster->textures[i].texels);
+    free(raster->primitives);
+    free(raster->bins);
+    free(raster->pixels);
+    set_zero(raster, sizeof(*raster));
+}
+
+u32 raster_create_texture(Raster *raster, const u8 *data, i32 width, i32 height){
+    assert(raster->texture_count + 1 < RASTER_MAX_TEXTURES);
+    u32 id = ++raster->texture_count;
+    RasterTexture *texture = &raster->textures[id];
+    texture->width  = width;
+    texture->height = height;
+    texture->texels = calloc((size_t)width * height, sizeof(u32));
+    assert(texture->texels);
+    if(data) memcpy(texture->texels, data, (size_t)width * height * sizeof(u32));
+    return id;
+}
+
+// Like glTexSubImage2D, y counts rows in GL order
+void raster_update_texture(Raster *raster, u32 id, i32 x, i32 y, i32 width, i32 height, const u8 *data){
+    assert(id > 0 && id <= (u32)raster->texture_count);
+    RasterTexture *texture = &raster->textures[id];
+    assert(x >= 0 && y >= 0 && x + width <= texture->width && y + height <= texture->height);
+    for(i32 row = 0; row < height; row++)
+        memcpy(texture->texels + (size_t)(y + row) * texture->width + x, data + (size_t)row * width * 4, (size_t)width * 4);
+}
+
+void raster_draw_frame(Raster *raster, const RenderFrame *frame){
+    raster->primitive_count = 0;
+    i32 tile_count = raster->tiles_x * raster->tiles_y;
+    for(i32 i = 0; i < tile_count; i++) raster->bins[i].count = 0;
+
+    for(i32 i = 0; i < frame->batch_count; i++){
+        const RenderBatch *batch = &frame->batches[i];
+        assert(!batch->textured || (batch->texture > 0 && batch->texture <= (u32)raster->texture_count));
+        BatchTransform transform;
+        set_batch_transform(raster, batch->uniforms, &transform);
+        if(batch->type == DRAW_SPRITE) setup_sprites(raster, frame, batch, &transform);
+        else                           setup_triangles(raster, frame, batch, &transform);
+    }
+
+    raster->frame = frame;
+    if(raster->pool){
+        for(i32 i = 0; i < tile_count; i++)
+            job_push(raster->pool, 0, draw_tile, &raster->bins[i]);
+        job_pool_wait(raster->pool, 0);
+    } else{
+        for(i32 i = 0; i < tile_count; i++)
+            draw_tile(NULL, 0, &raster->bins[i]);
+    }
+    raster->frame = NULL;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Cpu rasterizer for RenderFrames, for machines without a gpu (replays,
+// thumbnails, regression frames). Draws what the GL backend draws with
+// the shaders in shaders/: nearest sampling with repeat, the color
+// modulates the texel, src alpha blending for color and the source alpha
+// is written as is. A target smaller than the window scales the frame
+// down like a smaller viewport would.
+//
+// Batches are set up and binned to the RASTER_TILE_SIZE tiles they touch
+// on the calling thread, then each tile is one job that draws its bin in
+// frame order, so no two jobs touch the same pixel. Triangles are walked
+// row by row with exact integer edge functions (top left fill rule) and
+// spans are shaded and blended 4 pixels at a time with SSE2.
+
+#include "basic.h"
+#include "jobs.h"
+#include "render_backend.h"
+
+#define RASTER_TILE_SIZE    64
+#define RASTER_MAX_TEXTURES 64
+
+typedef struct{
+    u32 *texels; // RGBA8, rows in GL order, row 0 is v = 0
+    i32 width, height;
+}RasterTexture;
+
+typedef struct{
+    i32 width, height;
+    u32 *pixels; // RGBA8, rows from the top of the screen
+
+    RasterTexture textures[RASTER_MAX_TEXTURES]; // by id, 0 is no texture
+    i32 texture_count;
+
+    JobPool *pool; // NULL draws on the calling thread
+    i32 tiles_x, tiles_y;
+    struct RasterBin *bins;
+    struct RasterPrimitive *primitives;
+    i32 primitive_count;
+    i32 primitive_capacity;
+    const RenderFrame *frame; // while drawing
+}Raster;
+
+b32 raster_init(Raster *raster, i32 width, i32 height, JobPool *pool);
+void raster_free(Raster *raster);
+u32 raster_create_texture(Raster *raster, const u8 *data, i32 width, i32 height); // data can be NULL
+void raster_update_texture(Raster *raster, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data);
+void raster_draw_frame(Raster *raster, const RenderFrame *frame);
+
+// renderer_raster.c, a render backend that draws into raster
+RenderBackend *raster_backend_create(Raster *raster);
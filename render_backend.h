@@ -0,0 +1,135 @@
+#pragma once
+
+// A frame as renderer.c hands it to a backend: the vertex and sprite
+// instance streams of the frame and the batches that draw from them, in
+// draw order. Nothing in here knows about GL, raster.c draws the same
+// frames on the cpu.
+//
+// Backends: renderer_gl.c draws them, renderer_null.c only records and
+// counts them so the cpu side of a frame can be measured without a gpu,
+// renderer_raster.c draws them with raster.c. render_thread.c runs any of
+// them on a render thread.
+
+#include "basic.h"
+
+enum DrawPrimitiveTypes{
+    DRAW_NONE,
+    DRAW_TRIANGLE,
+    DRAW_SPRITE, // instanced, see draw_sprite
+};
+
+typedef struct{
+    i32 sample_tex;
+    float uv_matrix[3][3];
+    float ident_matrix[4][4];
+    float translation_matrix[4][4];
+}Uniforms;
+
+// 12 bytes. Positions are whole pixels, uvs are normalized u16 and the
+// color is RGBA8, the attribute fetch turns them back into floats
+typedef struct{
+    i16 position[2];
+    u16 texture_coord[2];
+    u32 color;
+}Vertex;
+
+// One per draw_sprite, expanded over a static unit quad by sprite.vert.
+// The on screen size is the atlas rect size, uvs come from textureSize.
+typedef struct{
+    i16 position[2];   // top left, pixels
+    u16 atlas_rect[4]; // x, y, w, h in atlas pixels, y from the top
+    u32 color;         // RGBA8
+}SpriteInstance;
+
+typedef struct{
+    i32 first, count; // vertices
+}VertexRange;
+
+// One draw call worth of state
+typedef struct{
+    i32 type;
+    struct S_ShaderContext *shader;
+    b32 textured; // false when the shader doesn't sample, texture is 0 then
+    u32 texture;
+    const Uniforms *uniforms;
+    // DRAW_SPRITE: instances [first, first + count)
+    // DRAW_TRIANGLE: ranges [first, first + count), triangle lists
+    i32 first, count;
+}RenderBatch;
+
+typedef struct{
+    b32 clear;
+    u32 clear_color; // RGBA8
+
+    const Vertex *vertices;
+    i32 vertex_count;
+    const SpriteInstance *instances;
+    i32 instance_count;
+    const VertexRange *ranges;
+    i32 range_count;
+    const RenderBatch *batches;
+    i32 batch_count;
+}RenderFrame;
+
+// Starting sizes of the backend streams, they double when a frame needs
+// more and never shrink
+#define VERTEX_ARENA_START   (1024 * 6)
+#define INSTANCE_ARENA_START (1024 * 4)
+
+// What renderer.c needs from a backend. The frontend writes vertices and
+// sprite instances straight into the backend's arrays (mapped buffer
+// memory for GL), so the pointers are only good until the next grow or
+// submit_frame and are read again after them.
+typedef struct RenderBackend{
+    const char *name;
+    Vertex *vertices;
+    i32 vertex_capacity;
+    SpriteInstance *instances;
+    i32 instance_capacity;
+
+    // only between submits, the first used vertices are kept
+    void (*grow_vertices)(struct RenderBackend *backend, i32 capacity, i32 used);
+    void (*grow_instances)(struct RenderBackend *backend, i32 capacity);
+    // RGBA8, rows bottom to top like glTexImage2D, data can be NULL
+    u32 (*create_texture)(struct RenderBackend *backend, const u8 *data, i32 width, i32 height);
+    void (*update_texture)(struct RenderBackend *backend, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data);
+    // frame->vertices and instances are the arrays above, or the ones
+    // they were before a reserve_streams
+    void (*submit_frame)(struct RenderBackend *backend, const RenderFrame *frame);
+    // Optional, for render_thread.c. Moves vertices and instances on to
+    // fresh memory for the next frame while the one recorded in the old
+    // arrays waits for its submit_frame, so the frontend can record
+    // straight into the streams while the frame before is submitted.
+    // Without it frames on the render thread are copied.
+    void (*reserve_streams)(struct RenderBackend *backend);
+}RenderBackend;
+
+// Totals since the backend was created
+typedef struct{
+    u64 frames;
+    u64 batches;        // draw calls for the GL backend
+    u64 state_changes;  // batches whose shader, texture or uniforms differ from the one before
+    u64 vertices, vertex_bytes;
+    u64 instances, instance_bytes;
+    u64 ranges;
+    u64 texture_creates, texture_updates, texture_bytes;
+    u64 grows;
+}RenderCounters;
+
+RenderBackend *gl_backend_create(void); // renderer_gl.c, expects a current GL 3.3 context
+
+// renderer_null.c, draws nothing. Every frame is copied out (batches,
+// ranges, uniforms and both streams) and counted, the copy stays until the
+// next submit.
+RenderBackend *null_backend_create(void);
+const RenderCounters *null_backend_counters(RenderBackend *backend);
+const RenderFrame *null_backend_last_frame(RenderBackend *backend);
+
+// render_thread.c, wraps backend and runs it on a thread of its own with
+// double buffered frame packets. bind runs first on the new thread (make
+// the GL context current there), present after every submitted frame
+// (swap buffers). Both can be NULL.
+typedef void RenderThreadProc(void *data);
+RenderBackend *render_thread_create(RenderBackend *backend, RenderThreadProc *bind, RenderThreadProc *present, void *data);
+void render_thread_flush(RenderBackend *threaded); // returns once the last frame is submitted
+void render_thread_destroy(RenderBackend *threaded);
@@ -0,0 +1,393 @@
+// Runs another backend on a thread of its own. The frontend records a frame
+// while the thread submits the one before, so the game logic of frame
+// N + 1 overlaps the submit and present of frame N. Only the render thread
+// calls into the wrapped backend, for GL that makes it the thread that
+// owns the context (see bind in render_thread_create).
+//
+// Batches, ranges and uniforms live in the frontend's arenas, they are
+// copied into one of two packets at handoff. Vertices and instances go
+// straight into the backend's streams when it has reserve_streams (GL with
+// persistent mapping, null): at handoff the render thread moves the
+// backend on to fresh stream memory for the next frame first, then submits
+// the frame from where it was recorded. Other backends get the streams
+// recorded into the packet and copied over on the render thread.
+//
+// One request is out at a time: submit_frame waits until the previous
+// frame is done with, then hands over the new one. Grows and texture calls
+// are synchronous, grows are rare and textures only change while loading.
+
+#include "basic.h"
+#include "engine.h"
+#include "profiler.h"
+#include "render_backend.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+typedef HANDLE Semaphore;
+typedef HANDLE Thread;
+
+static void semaphore_init(Semaphore *s){ *s = CreateSemaphoreA(NULL, 0, 1, NULL); }
+static void semaphore_free(Semaphore *s){ CloseHandle(*s); }
+static void semaphore_post(Semaphore *s){ ReleaseSemaphore(*s, 1, NULL); }
+static void semaphore_wait(Semaphore *s){ WaitForSingleObject(*s, INFINITE); }
+
+static DWORD WINAPI render_thread(LPVOID param);
+static void thread_start(Thread *thread, void *param){
+    *thread = CreateThread(NULL, 0, render_thread, param, 0, NULL);
+    assert(*thread);
+}
+static void thread_join(Thread *thread){
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+}
+#else
+#include <pthread.h>
+#include <semaphore.h>
+
+typedef sem_t Semaphore;
+typedef pthread_t Thread;
+
+static void semaphore_init(Semaphore *s){ sem_init(s, 0, 0); }
+static void semaphore_free(Semaphore *s){ sem_destroy(s); }
+static void semaphore_post(Semaphore *s){ sem_post(s); }
+static void semaphore_wait(Semaphore *s){ while(sem_wait(s) != 0); }
+
+static void *render_thread(void *param);
+static void thread_start(Thread *thread, void *param){
+    i32 result = pthread_create(thread, NULL, render_thread, param);
+    assert(result == 0);
+}
+static void thread_join(Thread *thread){
+    pthread_join(*thread, NULL);
+}
+#endif
+
+// Everything a frame needs after the frontend resets its arenas, the
+// batches point at the copied uniforms. Streams are only in here when the
+// backend can't reserve_streams.
+typedef struct{
+    RenderFrame frame;
+    Vertex *vertices;
+    i32 vertex_capacity;
+    SpriteInstance *instances;
+    i32 instance_capacity;
+    VertexRange *ranges;
+    i32 ranges_capacity;
+    RenderBatch *batches;
+    Uniforms *uniforms;
+    i32 batches_capacity;
+}FramePacket;
+
+enum RenderRequests{
+    REQUEST_FRAME,
+    REQUEST_GROW_VERTICES,
+    REQUEST_GROW_INSTANCES,
+    REQUEST_CREATE_TEXTURE,
+    REQUEST_UPDATE_TEXTURE,
+    REQUEST_QUIT,
+};
+
+typedef struct{
+    RenderBackend base; // first, the vtable gets this back as a RenderBackend
+    RenderBackend *backend;
+    RenderThreadProc *bind, *present;
+    void *data;
+    char name[32];
+    b32 in_place; // recording into the backend's streams
+
+    FramePacket packets[2];
+    i32 recording; // the packet the frontend is filling
+    b32 busy;      // a request is out, only the main thread touches it
+
+    // The request, written before ready is posted and read back after done
+    i32 request;
+    FramePacket *packet;
+    u32 texture;
+    i32 x, y, width, height; // textures
+    i32 capacity, used;      // grows
+    const u8 *texture_data;
+
+    Semaphore ready, done;
+    Semaphore reserved; // in place frames, the next streams are in base
+    Thread thread;
+}RenderThread;
+
+static RenderThread Render;
+
+// Contents aren't kept, everything in here is overwritten each frame
+static void *ensure_capacity(void *array, i32 *capacity, i32 count, size_t item_size){
+    if(count <= *capacity) return array;
+    i32 grown = MAX(*capacity, 64);
+    while(grown < count) grown *= 2;
+    if(array) os_memory_free(array);
+    array = os_memory_alloc(item_size * grown);
+    assert(array);
+    *capacity = grown;
+    return array;
+}
+
+// Where the frontend records next, the backend's streams or the packet's.
+// In place this runs on the render thread, before it posts.
+static void take_streams(RenderThread *render){
+    if(render->in_place){
+        render->base.vertices = render->backend->vertices;
+        render->base.vertex_capacity = render->backend->vertex_capacity;
+        render->base.instances = render->backend->instances;
+        render->base.instance_capacity = render->backend->instance_capacity;
+    } else{
+        FramePacket *packet = &render->packets[render->recording];
+        render->base.vertices = packet->vertices;
+        render->base.vertex_capacity = packet->vertex_capacity;
+        render->base.instances = packet->instances;
+        render->base.instance_capacity = packet->instance_capacity;
+    }
+}
+
+// Copy path, moves a packet's streams into the backend's
+static void copy_packet_streams(RenderBackend *backend, RenderFrame *frame){
+    PROFILE_BEGIN("copy_packet_streams");
+    if(frame->vertex_count > backend->vertex_capacity)
+        backend->grow_vertices(backend, MAX(frame->vertex_count, backend->vertex_capacity * 2), 0);
+    if(frame->instance_count > backend->instance_capacity)
+        backend->grow_instances(backend, MAX(frame->instance_count, backend->instance_capacity * 2));
+    memcpy(backend->vertices, frame->vertices, sizeof(Vertex) * frame->vertex_count);
+    memcpy(backend->instances, frame->instances, sizeof(SpriteInstance) * frame->instance_count);
+    frame->vertices  = backend->vertices;
+    frame->instances = backend->instances;
+    PROFILE_END();
+}
+
+static void submit_packet(RenderThread *render, FramePacket *packet){
+    RenderBackend *backend = render->backend;
+    RenderFrame frame = packet->frame;
+    if(render->in_place){
+        // the frontend waits for this before it records the next frame
+        backend->reserve_streams(backend);
+        take_streams(render);
+        semaphore_post(&render->reserved);
+    } else{
+        copy_packet_streams(backend, &frame);
+    }
+
+    PROFILE_BEGIN("submit_packet");
+    backend->submit_frame(backend, &frame);
+    PROFILE_END();
+    if(render->present){
+        PROFILE_BEGIN("present");
+        render->present(render->data);
+        PROFILE_END();
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI render_thread(LPVOID param){
+#else
+static void *render_thread(void *param){
+#endif
+    RenderThread *render = param;
+    profiler_thread_name("render");
+    if(render->bind) render->bind(render->data);
+
+    for(;;){
+        semaphore_wait(&render->ready);
+        RenderBackend *backend = render->backend;
+        switch(render->request){
+            case REQUEST_FRAME:
+                submit_packet(render, render->packet);
+                break;
+            case REQUEST_GROW_VERTICES:
+                backend->grow_vertices(backend, render->capacity, render->used);
+                take_streams(render);
+                break;
+            case REQUEST_GROW_INSTANCES:
+                backend->grow_instances(backend, render->capacity);
+                take_streams(render);
+                break;
+            case REQUEST_CREATE_TEXTURE:
+                render->texture = backend->create_texture(backend, render->texture_data, render->width, render->height);
+                break;
+            case REQUEST_UPDATE_TEXTURE:
+                backend->update_texture(backend, render->texture, render->x, render->y,
+                    render->width, render->height, render->texture_data);
+                break;
+            case REQUEST_QUIT:
+                semaphore_post(&render->done);
+                return 0;
+            default:
+                assert(false);
+        }
+        semaphore_post(&render->done);
+    }
+}
+
+// Main thread side
+
+static void wait_render_thread(RenderThread *render){
+    if(!render->busy) return;
+    PROFILE_BEGIN("wait_render_thread");
+    semaphore_wait(&render->done);
+    PROFILE_END();
+    render->busy = false;
+}
+
+static void send_request(RenderThread *render, i32 request){
+    assert(!render->busy);
+    render->request = request;
+    render->busy = true;
+    semaphore_post(&render->ready);
+}
+
+static void thread_grow_vertices(RenderBackend *backend, i32 capacity, i32 used){
+    RenderThread *render = (RenderThread*)backend;
+    if(render->in_place){
+        wait_render_thread(render); // the frame before is drawn from the old streams
+        render->capacity = capacity;
+        render->used = used;
+        send_request(render, REQUEST_GROW_VERTICES);
+        wait_render_thread(render);
+        return;
+    }
+    FramePacket *packet = &render->packets[render->recording];
+    Vertex *grown = os_memory_alloc(sizeof(Vertex) * capacity);
+    assert(grown);
+    memcpy(grown, packet->vertices, sizeof(Vertex) * used);
+    os_memory_free(packet->vertices);
+    packet->vertices = grown;
+    packet->vertex_capacity = capacity;
+    take_streams(render);
+}
+
+static void thread_grow_instances(RenderBackend *backend, i32 capacity){
+    RenderThread *render = (RenderThread*)backend;
+    if(render->in_place){
+        wait_render_thread(render);
+        render->capacity = capacity;
+        send_request(render, REQUEST_GROW_INSTANCES);
+        wait_render_thread(render);
+        return;
+    }
+    FramePacket *packet = &render->packets[render->recording];
+    os_memory_free(packet->instances);
+    packet->instances = os_memory_alloc(sizeof(SpriteInstance) * capacity);
+    assert(packet->instances);
+    packet->instance_capacity = capacity;
+    take_streams(render);
+}
+
+static u32 thread_create_texture(RenderBackend *backend, const u8 *data, i32 width, i32 height){
+    RenderThread *render = (RenderThread*)backend;
+    wait_render_thread(render);
+    render->texture_data = data;
+    render->width = width;
+    render->height = height;
+    send_request(render, REQUEST_CREATE_TEXTURE);
+    wait_render_thread(render);
+    return render->texture;
+}
+
+static void thread_update_texture(RenderBackend *backend, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data){
+    RenderThread *render = (RenderThread*)backend;
+    wait_render_thread(render);
+    render->texture = texture;
+    render->x = x;
+    render->y = y;
+    render->width = width;
+    render->height = height;
+    render->texture_data = data;
+    send_request(render, REQUEST_UPDATE_TEXTURE);
+    wait_render_thread(render); // data is only good until we return
+}
+
+static void thread_submit_frame(RenderBackend *backend, const RenderFrame *frame){
+    RenderThread *render = (RenderThread*)backend;
+    FramePacket *packet = &render->packets[render->recording];
+    assert(frame->vertices == render->base.vertices && frame->instances == render->base.instances);
+
+    packet->ranges = ensure_capacity(packet->ranges, &packet->ranges_capacity, frame->range_count, sizeof(VertexRange));
+    i32 uniforms_capacity = packet->batches_capacity; // same size as batches
+    packet->batches  = ensure_capacity(packet->batches, &packet->batches_capacity, frame->batch_count, sizeof(RenderBatch));
+    packet->uniforms = ensure_capacity(packet->uniforms, &uniforms_capacity, frame->batch_count, sizeof(Uniforms));
+    memcpy(packet->ranges, frame->ranges, sizeof(VertexRange) * frame->range_count);
+    for(i32 i = 0; i < frame->batch_count; i++){
+        packet->uniforms[i] = *frame->batches[i].uniforms;
+        packet->batches[i] = frame->batches[i];
+        packet->batches[i].uniforms = &packet->uniforms[i];
+    }
+    packet->frame = *frame;
+    packet->frame.ranges  = packet->ranges;
+    packet->frame.batches = packet->batches;
+
+    wait_render_thread(render); // the other packet is free after this
+    render->packet = packet;
+    send_request(render, REQUEST_FRAME);
+    render->recording ^= 1;
+    if(render->in_place){
+        PROFILE_BEGIN("wait_reserve_streams");
+        semaphore_wait(&render->reserved);
+        PROFILE_END();
+    } else{
+        take_streams(render);
+    }
+}
+
+RenderBackend *render_thread_create(RenderBackend *backend, RenderThreadProc *bind, RenderThreadProc *present, void *data){
+    set_zero(&Render, sizeof(Render));
+    Render.backend = backend;
+    Render.bind = bind;
+    Render.present = present;
+    Render.data = data;
+    Render.in_place = backend->reserve_streams != NULL;
+    snprintf(Render.name, sizeof(Render.name), "%s on a thread%s", backend->name, Render.in_place? "" : " (copied)");
+    Render.base = (RenderBackend){
+        .name = Render.name,
+        .grow_vertices = thread_grow_vertices,
+        .grow_instances = thread_grow_instances,
+        .create_texture = thread_create_texture,
+        .update_texture = thread_update_texture,
+        .submit_frame = thread_submit_frame,
+    };
+    if(!Render.in_place){
+        for(i32 i = 0; i < 2; i++){
+            FramePacket *packet = &Render.packets[i];
+            packet->vertices = os_memory_alloc(sizeof(Vertex) * VERTEX_ARENA_START);
+            packet->vertex_capacity = VERTEX_ARENA_START;
+            packet->instances = os_memory_alloc(sizeof(SpriteInstance) * INSTANCE_ARENA_START);
+            packet->instance_capacity = INSTANCE_ARENA_START;
+            assert(packet->vertices && packet->instances);
+        }
+    }
+    take_streams(&Render); // before the thread starts, nothing else touches them yet
+
+    semaphore_init(&Render.ready);
+    semaphore_init(&Render.done);
+    semaphore_init(&Render.reserved);
+    thread_start(&Render.thread, &Render);
+    return &Render.base;
+}
+
+void render_thread_flush(RenderBackend *backend){
+    assert(backend == &Render.base);
+    wait_render_thread(&Render);
+}
+
+void render_thread_destroy(RenderBackend *backend){
+    assert(backend == &Render.base);
+    wait_render_thread(&Render);
+    send_request(&Render, REQUEST_QUIT);
+    wait_render_thread(&Render);
+    thread_join(&Render.thread);
+    semaphore_free(&Render.ready);
+    semaphore_free(&Render.done);
+    semaphore_free(&Render.reserved);
+    for(i32 i = 0; i < 2; i++){
+        FramePacket *packet = &Render.packets[i];
+        if(packet->vertices)  os_memory_free(packet->vertices);
+        if(packet->instances) os_memory_free(packet->instances);
+        if(packet->ranges)    os_memory_free(packet->ranges);
+        if(packet->batches)   os_memory_free(packet->batches);
+        if(packet->uniforms)  os_memory_free(packet->uniforms);
+    }
+}
@@ -1,62 +1,16 @@
-#include <GL/glcorearb.h>
+// The api the game draws with. Draws are recorded as commands into per
+// frame arenas, vertices and sprite instances go straight into the
+// backend's streams, and execute_draw_commands sorts the commands into
+// batches and hands the frame to the backend (see render_backend.h).
+
 #include "engine.h"
 #include "game.h"
 #include "renderer.h"
-#include "opengl_api.h"
+#include "profiler.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-// Opengl reminders:
-// It is advised however, that you stick to powers-of-two for
-// texture sizes, unless you have a significant need to use arbitrary sizes.
-
-PFNGLCREATESHADERPROC  glCreateShader;
-PFNGLSHADERSOURCEPROC  glShaderSource;
-PFNGLCOMPILESHADERPROC glCompileShader;
-PFNGLGETSHADERIVPROC   glGetShaderiv;
-PFNGLCREATEPROGRAMPROC glCreateProgram;
-PFNGLLINKPROGRAMPROC   glLinkProgram;
-PFNGLGETPROGRAMIVPROC  glGetProgramiv;
-PFNGLUSEPROGRAMPROC    glUseProgram;
-PFNGLDELETEPROGRAMPROC glDeleteProgram;
-PFNGLATTACHSHADERPROC  glAttachShader;
-PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
-PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog;
-PFNGLGENBUFFERSPROC    glGenBuffers;
-PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
-PFNGLBINDBUFFERPROC glBindBuffer;
-PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
-PFNGLBUFFERDATAPROC glBufferData;
-PFNGLBUFFERSUBDATAPROC glBufferSubData;
-PFNGLUNIFORM3FVPROC glUniform3fv;
-PFNGLUNIFORM2FPROC glUniform2f;
-PFNGLUNIFORM1IPROC glUniform1i;
-PFNGLUNIFORM1IVPROC glUniform1iv;
-PFNGLDELETESHADERPROC glDeleteShader;
-PFNGLBINDATTRIBLOCATIONPROC glBindAttribLocation;
-PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv;
-PFNGLUNIFORMMATRIX3FVPROC glUniformMatrix3fv;
-PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
-PFNGLACTIVETEXTUREPROC glActiveTexture;
-PFNGLBLENDEQUATIONSEPARATEPROC glBlendEquationSeparate;
-PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
-PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstanced;
-PFNGLBINDTEXTUREUNITPROC glBindTextureUnit;
-PFNGLGETSTRINGIPROC glGetStringi;
-
-PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
-PFNGLVERTEXATTRIBIPOINTERPROC glVertexAttribIPointer;
-
-PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
-PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
-
-typedef struct{
-    f32 position[2];
-    f32 texture_coord[2];
-    f32 color[4];
-}Vertex;
-
 typedef struct{
     Vertex v0, v1, v2;
     Vertex v3, v4, v5;
@@ -69,111 +23,179 @@ const Vec4 Green_v4  = {0.0f, 1.0f, 0.0f, 1.0f};
 const Vec4 Blue_v4   = {0.0f, 0.0f, 1.0f, 1.0f};
 const Vec4 Yellow_v4 = {1.0f, 1.0f, 0.0f, 1.0f};
 
-struct S_ShaderContext PrimitiveShader;
-struct S_ShaderContext TextureShader;
-
-static GLuint vertex_array_obj, vertex_buffer_obj;
+// sort_id is the order the shaders go in the sort key
+ShaderContext TextureShader   = {1, true,  "shaders/simple.vert",    "shaders/simple.frag"};
+ShaderContext PrimitiveShader = {2, false, "shaders/primitive.vert", "shaders/primitive.frag"};
+ShaderContext SpriteShader    = {3, true,  "shaders/sprite.vert",    "shaders/simple.frag"};
+
+// Starting sizes of the per frame arenas. They double when a frame needs
+// more and never shrink, so they settle at the high-water mark and a
+// frame is always submitted in one go by execute_draw_commands. The
+// vertex and instance streams belong to the backend and grow the same way.
+#define COMMAND_ARENA_START  (1024 * 4)
+#define UNIFORMS_ARENA_START 16
+#define UNIFORMS_MAX         256 // 8 bits in the sort key
+
+#define ATLAS_SIZE    1024 // the minimum GL 3.3 guarantees
+#define ATLAS_PADDING 1
+
+// The one texture every Sprite and Font points into. Bitmaps are packed
+// in shelves from row 0 up (GL row order), the rects handed out count
+// y from the top of the texture like the rest of the sprite code.
+static struct{
+    TextureInfo texture;
+    i32 shelf_x, shelf_y, shelf_height;
+}Atlas;
 
-static Vertex VertexBuffer[1024 * 6];
+static RenderBackend *Backend;
 static i32 VertexCount = 0;
 
 // @Debug
 i32 FrameVertexCount = 0;
+i32 FrameSpriteCount = 0;
 i32 FrameDrawCallsCount = 0;
-
-typedef struct{
-    i32 sample_tex;
-    float uv_matrix[3][3];
-    float ident_matrix[4][4];
-    float translation_matrix[4][4];
-}Uniforms;
+static i32 FrameCommandCount = 0;
+static i32 ArenaGrowCount = 0; // @Debug since start, command, vertex and sprite arenas
+static struct{
+    i32 vertices, sprites, commands, draw_calls;
+}LastFrameStats;
+
+// Draw command sort key, most significant bits first:
+//   layer 6 | shader 6 | type 2 | uniforms 8 | texture 16 | sequence 26
+// Sorting groups each layer by state and keeps submission order inside a
+// group, one group is one draw call. The sequence is also the index in
+// CommandList.commands.
+#define KEY_SEQUENCE_BITS 26
+#define KEY_TEXTURE_SHIFT KEY_SEQUENCE_BITS
+#define KEY_UNIFORMS_SHIFT (KEY_TEXTURE_SHIFT + 16)
+#define KEY_TYPE_SHIFT     (KEY_UNIFORMS_SHIFT + 8)
+#define KEY_SHADER_SHIFT   (KEY_TYPE_SHIFT + 2)
+#define KEY_LAYER_SHIFT    (KEY_SHADER_SHIFT + 6)
 
 typedef struct{
     i32 type;
     u32 tex_id;
-    i32 vertices_count;
     ShaderContext *shader_context;
-    Uniforms uniforms;
+    i32 layer;
+    i32 first_vertex; // in the current vertex region
+    i32 vertices_count;
+    SpriteInstance instance; // DRAW_SPRITE only, written out sorted
 }DrawCommand;
 
+// Every array here has room for capacity commands
 static struct{
-    DrawCommand batchs[32];
-    DrawCommand *current;
+    DrawCommand *commands;
+    u64 *keys;
+    u64 *sort_scratch;
+    RenderBatch *batches;
+    VertexRange *ranges;
     i32 count;
-}BatchList;
+    i32 capacity;
+
+    Uniforms *uniforms;
+    i32 uniforms_count;
+    i32 uniforms_capacity;
+}CommandList;
 
 typedef struct {
     b32 drawing;
 
     // Draw State
     // - per vertex effect
-    Vec2 texture_coord;
-    Vec4 color;
+    u16 texture_coord[2]; // already packed for set_vertex
+    u32 color;
 
     // - global effect
     Uniforms uniforms;
+    i32 uniforms_index; // in CommandList, -1 when uniforms changed
+    i32 layer;
+    b32 clear; // clear_screen was called this frame
+    u32 clear_color;
 
     DrawCommand command;
 }T_DrawContext;
 
 T_DrawContext DrawContext = {0};
 
-static GLuint create_program(HANDLE vert_file, HANDLE frag_file);
-static b32 compile_shader(GLuint shader);
+static void reset_draw_commands(void){
+    CommandList.count = 0;
+    CommandList.uniforms_count = 0;
+    DrawContext.uniforms_index = -1;
+    DrawContext.clear = false;
+    VertexCount = 0;
+}
 
-static void reset_draw_batchs(i32 vertices_left){
-    set_zero(BatchList.batchs, sizeof(DrawCommand) * BatchList.count);
-    BatchList.count = 0;
-    BatchList.current = NULL;
-    VertexCount = vertices_left;
+static void *grow_array(void *array, i32 count, i32 new_capacity, size_t item_size){
+    void *grown = os_memory_alloc(item_size * new_capacity);
+    assert(grown);
+    if(array){
+        memcpy(grown, array, item_size * count);
+        os_memory_free(array);
+    }
+    return grown;
 }
 
-static inline void use_shader_context(ShaderContext *context){
-    void *vert_info = context->debug_info.vert_file_info;
-    void *frag_info = context->debug_info.frag_file_info;
+static void grow_command_arena(i32 capacity){
+    i32 count = CommandList.count;
+    CommandList.commands     = grow_array(CommandList.commands, count, capacity, sizeof(DrawCommand));
+    CommandList.keys         = grow_array(CommandList.keys, count, capacity, sizeof(u64));
+    CommandList.sort_scratch = grow_array(CommandList.sort_scratch, 0, capacity, sizeof(u64));
+    CommandList.batches      = grow_array(CommandList.batches, 0, capacity, sizeof(RenderBatch));
+    CommandList.ranges       = grow_array(CommandList.ranges, 0, capacity, sizeof(VertexRange));
+    CommandList.capacity = capacity;
+}
 
-    if(update_file_info(vert_info) | update_file_info(frag_info)){
-        printf("updating\n");
-        HANDLE vert_file = get_file_handle(vert_info);
-        HANDLE frag_file = get_file_handle(frag_info);
-        b32 new_program = create_program(vert_file, frag_file);
+// LSD radix sort, 8 bits a pass. Passes where every key has the same
+// digit are skipped, most of the high bits are equal in a frame.
+static void radix_sort_keys(u64 *keys, u64 *scratch, i32 count){
+    u32 histograms[8][256];
+    set_zero(histograms, sizeof(histograms));
+    for(i32 i = 0; i < count; i++){
+        u64 key = keys[i];
+        for(i32 d = 0; d < 8; d++)
+            histograms[d][(key >> (d * 8)) & 0xff]++;
+    }
 
-        if(new_program){
-            glDeleteProgram(context->program_id);
-            context->program_id = new_program;
+    u64 *src = keys, *dst = scratch;
+    for(i32 d = 0; d < 8; d++){
+        u32 *histogram = histograms[d];
+        if(histogram[(src[0] >> (d * 8)) & 0xff] == (u32)count)
+            continue;
+
+        u32 offset = 0;
+        for(i32 i = 0; i < 256; i++){
+            u32 n = histogram[i];
+            histogram[i] = offset;
+            offset += n;
+        }
+        for(i32 i = 0; i < count; i++){
+            u64 key = src[i];
+            dst[histogram[(key >> (d * 8)) & 0xff]++] = key;
         }
+        u64 *swap = src; src = dst; dst = swap;
     }
-
-    glUseProgram(context->program_id);
-}
-
-u32 get_gl_mode(u32 renderer_type){
-    renderer_type -= 1;
-    assert(renderer_type >= 0);
-    u32 lookup_table[] = {GL_TRIANGLES};
-    assert(renderer_type < array_size(lookup_table));
-    return lookup_table[renderer_type];
+    if(src != keys) memcpy(keys, src, sizeof(*keys) * count);
 }
 
 static void set_default_uniforms(Uniforms *uniforms){
     float a = 2.0f / WWIDTH;
     float b = 2.0f / WHEIGHT;
 
-    const GLfloat translation_matrix[4][4] = {
+    const f32 translation_matrix[4][4] = {
         {   a,  0.0,  0.0, -1.0},
         { 0.0,   -b,  0.0,  1.0},
         { 0.0,  0.0,  1.0,  0.0},
         { 0.0,  0.0,  0.0,  1.0}
     };
 
-    const GLfloat ident_matrix[4][4] = {
+    const f32 ident_matrix[4][4] = {
         { 1.0,  0.0,  0.0,  0.0},
         { 0.0,  1.0,  0.0,  0.0},
         { 0.0,  0.0,  1.0,  0.0},
         { 0.0,  0.0,  0.0,  1.0}
     };
 
-    const GLfloat uv_matrix[3][3] = {
+    const f32 uv_matrix[3][3] = {
         { 1.0,  0.0,  0.0},
         { 0.0,  1.0,  0.0},
         { 0.0,  0.0,  1.0},
@@ -186,205 +208,182 @@ static void set_default_uniforms(Uniforms *uniforms){
     memcpy(uniforms->translation_matrix, translation_matrix, sizeof(translation_matrix));
 }
 
-void update_shader_uniforms(u32 program, const Uniforms *uniforms){
-    i32 location;
-    // TODO save the location instead. Save in the shader_context?
-    location = glGetUniformLocation(program, "ident_matrix");
-    glUniformMatrix4fv(location, 1, GL_TRUE, (float*)uniforms->ident_matrix);
-
-    location = glGetUniformLocation(program, "trans_matrix");
-    glUniformMatrix4fv(location, 1, GL_TRUE, (float*)uniforms->translation_matrix);
-
-    location = glGetUniformLocation(program, "texture_trans_matrix");
-    glUniformMatrix3fv(location, 1, GL_TRUE, (float*)uniforms->uv_matrix);
-
-    location = glGetUniformLocation(program, "sample_tex");
-    glUniform1i(location, uniforms->sample_tex);
-}
-
+// Draw calls are only known once the frame is flushed, so this shows the
+// previous frame
 void show_rederer_debug_info(f32 x, f32 y){
     set_font(&DebugFont);
-    draw_text(x, y, Yellow_v4, "Vertex: %d DrawCalls: %d", FrameVertexCount, BatchList.count + FrameDrawCallsCount);
+    set_layer(LAYER_DEBUG_TEXT);
+    i32 upload = LastFrameStats.vertices * (i32)sizeof(Vertex) + LastFrameStats.sprites * (i32)sizeof(SpriteInstance);
+    draw_text(x, y, Yellow_v4, "Vertex: %d Sprites: %d Upload: %dB Commands: %d DrawCalls: %d Grows: %d", LastFrameStats.vertices,
+        LastFrameStats.sprites, upload, LastFrameStats.commands, LastFrameStats.draw_calls, ArenaGrowCount);
     set_font(&DefaultFont);
 }
 
-void execute_draw_commands(void){
-    i32 vertices_start = 0;
-    i32 vertices_end   = VertexCount;
-    i32 vertices_left  = 0;
-    
-    if(DrawContext.drawing){
-        vertices_end -= DrawContext.command.vertices_count;
-        vertices_left = DrawContext.command.vertices_count;
-    }
-    glBufferSubData(GL_ARRAY_BUFFER, vertices_start, sizeof(Vertex) * vertices_end, VertexBuffer);
-
-    // @Debug
-    FrameDrawCallsCount += BatchList.count;
-    for(i32 i = 0; i < BatchList.count; i++){
-        DrawCommand *batch = &BatchList.batchs[i];
-        assert(batch->type && batch->shader_context);
-        use_shader_context(batch->shader_context);
-        update_shader_uniforms(batch->shader_context->program_id, &batch->uniforms);
-        glBindTexture(GL_TEXTURE_2D, batch->tex_id);
-        u32 gl_mode = get_gl_mode(batch->type);
-        glDrawArrays(gl_mode, vertices_start, batch->vertices_count);
-        vertices_start += batch->vertices_count;
-    }
+void reset_frame_stats(void){
+    LastFrameStats.vertices   = FrameVertexCount;
+    LastFrameStats.sprites    = FrameSpriteCount;
+    LastFrameStats.commands   = FrameCommandCount;
+    LastFrameStats.draw_calls = FrameDrawCallsCount;
+    FrameVertexCount    = 0;
+    FrameSpriteCount    = 0;
+    FrameDrawCallsCount = 0;
+    FrameCommandCount   = 0;
+}
 
-    if(vertices_left){
-        // @Debug @Remove
-        printf("\nWARNING!!!\n");
-        printf("Scene using too much vetices!\n");
+// Sorted commands to batches, one per run of equal state. Sprite
+// instances are written out in batch order, so every sprite batch is one
+// instance range.
+static void build_render_frame(RenderFrame *frame){
+    i32 count = CommandList.count;
+    u64 *keys = CommandList.keys;
+    if(count) radix_sort_keys(keys, CommandList.sort_scratch, count);
+
+    i32 sprites = 0;
+    for(i32 i = 0; i < count; i++)
+        sprites += CommandList.commands[i].type == DRAW_SPRITE;
+    if(sprites > Backend->instance_capacity){
+        i32 capacity = Backend->instance_capacity;
+        while(capacity < sprites) capacity *= 2;
+        Backend->grow_instances(Backend, capacity);
+        ArenaGrowCount++; // @Debug
+    }
 
-        i32 size  = sizeof(Vertex) * vertices_left;
-        memmove(VertexBuffer, VertexBuffer + vertices_end, size);
+    SpriteInstance *instances = Backend->instances;
+    i32 instance_count = 0;
+    i32 batch_count = 0;
+    i32 range_count = 0;
+    for(i32 i = 0; i < count;){
+        u64 state = keys[i] >> KEY_SEQUENCE_BITS;
+        i32 group_end = i + 1;
+        while(group_end < count && keys[group_end] >> KEY_SEQUENCE_BITS == state)
+            group_end++;
+
+        const DrawCommand *command = &CommandList.commands[keys[i] & ((1 << KEY_SEQUENCE_BITS) - 1)];
+        assert(command->type && command->shader_context);
+        RenderBatch *batch = &CommandList.batches[batch_count++];
+        batch->type = command->type;
+        batch->shader = command->shader_context;
+        batch->textured = command->shader_context->textured;
+        batch->texture = command->tex_id;
+        batch->uniforms = &CommandList.uniforms[(state >> (KEY_UNIFORMS_SHIFT - KEY_SEQUENCE_BITS)) & 0xff];
+
+        if(batch->type == DRAW_SPRITE){
+            batch->first = instance_count;
+            for(i32 j = i; j < group_end; j++)
+                instances[instance_count++] = CommandList.commands[keys[j] & ((1 << KEY_SEQUENCE_BITS) - 1)].instance;
+        } else{
+            // Vertices stay where draw_begin put them, ranges that touch are joined
+            batch->first = range_count;
+            for(i32 j = i; j < group_end; j++){
+                command = &CommandList.commands[keys[j] & ((1 << KEY_SEQUENCE_BITS) - 1)];
+                VertexRange *last = range_count > batch->first? &CommandList.ranges[range_count - 1] : NULL;
+                if(last && last->first + last->count == command->first_vertex){
+                    last->count += command->vertices_count;
+                } else{
+                    CommandList.ranges[range_count++] = (VertexRange){command->first_vertex, command->vertices_count};
+                }
+            }
+        }
+        batch->count = batch->type == DRAW_SPRITE? instance_count - batch->first : range_count - batch->first;
+        i = group_end;
     }
 
-    reset_draw_batchs(vertices_left);
+    *frame = (RenderFrame){
+        .clear = DrawContext.clear,
+        .clear_color = DrawContext.clear_color,
+        .vertices = Backend->vertices,
+        .vertex_count = VertexCount,
+        .instances = instances,
+        .instance_count = instance_count,
+        .ranges = CommandList.ranges,
+        .range_count = range_count,
+        .batches = CommandList.batches,
+        .batch_count = batch_count,
+    };
 }
 
-u32 create_texture_from_bitmap(u8 *data, i32 width, i32 height){
-    u32 id;
-    glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return id;
+void execute_draw_commands(void){
+    assert(!DrawContext.drawing); // missing draw_end
+    PROFILE_BEGIN("execute_draw_commands");
+    FrameCommandCount += CommandList.count; // @Debug
+
+    RenderFrame frame;
+    PROFILE_BEGIN("build_render_frame");
+    build_render_frame(&frame);
+    PROFILE_END();
+    PROFILE_BEGIN("submit_frame");
+    Backend->submit_frame(Backend, &frame);
+    PROFILE_END();
+    FrameDrawCallsCount += frame.batch_count; // @Debug one draw call a batch
+    reset_draw_commands();
+    PROFILE_END();
 }
 
-TextureInfo load_texture(const char *file_name){
-    TextureInfo tex;
-    u8 *texture_data = stbi_load(file_name, &tex.width, &tex.height, NULL, 4);
-    assert(texture_data);
-    tex.id = create_texture_from_bitmap(texture_data, tex.width, tex.height);
-    stbi_image_free(texture_data);
-    return tex;
+u32 create_texture_from_bitmap(u8 *data, i32 width, i32 height){
+    return Backend->create_texture(Backend, data, width, height);
 }
 
-static GLuint create_program(HANDLE vert_file, HANDLE frag_file){
-    i32 result;
-    char error_buffer[200];
-    i32 error_string_size;
-
-    i32 vert_size, frag_size;
-    char *vert_data = (char*)os_read_whole_file_handle(vert_file, &vert_size);
-    char *frag_data = (char*)os_read_whole_file_handle(frag_file, &frag_size);
-
-    GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
-    GLuint vert = glCreateShader(GL_VERTEX_SHADER);
-
-    glShaderSource(frag, 1, &frag_data, &frag_size);
-    glShaderSource(vert, 1, &vert_data, &vert_size);
-
-    os_memory_free(vert_data);
-    os_memory_free(frag_data);
-
-    if(!compile_shader(frag) || !compile_shader(vert))
-         return 0;
-
-    GLuint program = glCreateProgram();
-
-    glAttachShader(program, vert);
-    glAttachShader(program, frag);
-    glGetProgramiv(program, GL_ATTACHED_SHADERS, &result);
-    assert(result == 2);
+// data is RGBA8, rows bottom to top like glTexImage2D wants them.
+// Returns false and leaves the atlas as it was when the bitmap doesn't fit.
+b32 atlas_add_bitmap(Sprite *sprite, const u8 *data, i32 width, i32 height){
+    i32 x = Atlas.shelf_x;
+    i32 y = Atlas.shelf_y;
+    i32 shelf_height = Atlas.shelf_height;
+    if(x + width > ATLAS_SIZE){
+        x = 0;
+        y += shelf_height;
+        shelf_height = 0;
+    }
+    if(width > ATLAS_SIZE || y + height > ATLAS_SIZE) return false;
 
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &result);
-    glGetProgramInfoLog(program, sizeof(error_buffer), &error_string_size, error_buffer);
-    printf("Link:\n%s\n", error_buffer);
-    if(!result) return 0;
+    Backend->update_texture(Backend, Atlas.texture.id, x, y, width, height, data);
 
-    glDeleteShader(frag);
-    glDeleteShader(vert);
+    Atlas.shelf_x = x + width + ATLAS_PADDING;
+    Atlas.shelf_y = y;
+    Atlas.shelf_height = MAX(shelf_height, height + ATLAS_PADDING);
 
-    return program;
+    *sprite = (Sprite){
+        .x = x,
+        .y = ATLAS_SIZE - y - height,
+        .w = width,
+        .h = height,
+        .atlas = Atlas.texture,
+    };
+    return true;
 }
 
-static b32 compile_shader(GLuint shader){
-    char error_buffer[400];
-    i32 error_string_size, result;
-    glCompileShader(shader);
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-    glGetShaderInfoLog(shader, sizeof(error_buffer), &error_string_size, error_buffer);
-    printf("Shader Compilation:\n%s", error_buffer);
+b32 load_sprite_sheet(Sprite *sheet, const char *file_name){
+    i32 width, height;
+    u8 *data = stbi_load(file_name, &width, &height, NULL, 4);
+    if(!data) return false;
+    b32 result = atlas_add_bitmap(sheet, data, width, height);
+    stbi_image_free(data);
     return result;
 }
 
-static b32 create_shader_context(ShaderContext *context, const char *vert_shader, const char *frag_shader){
-    void *vert_file = os_open_file(vert_shader);
-    void *frag_file = os_open_file(frag_shader);
-    assert(vert_file && frag_file);
-
-    GLuint program = create_program(vert_file, frag_file);
-    if(!program)
-        return false;
-
-    context->program_id = program;
-    // Debug
-    context->debug_info.vert_file_info = create_file_info(vert_file);
-    context->debug_info.frag_file_info = create_file_info(frag_file);
-
-    return true;
-}
-
-static void print_all_gl_extensions(void){
-    i32 num;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &num);
-    printf("max texture size:%dx%d\n", num / 2, num / 2);
-    glGetIntegerv(GL_NUM_EXTENSIONS, &num);
-    printf("extension number:%d\n", num);
-    for(i32 i = 0; i < num; i++){
-        printf(" %s\n", glGetStringi(GL_EXTENSIONS, i));
-    }
+TextureInfo load_texture(const char *file_name){
+    TextureInfo tex;
+    u8 *texture_data = stbi_load(file_name, &tex.width, &tex.height, NULL, 4);
+    assert(texture_data);
+    tex.id = create_texture_from_bitmap(texture_data, tex.width, tex.height);
+    stbi_image_free(texture_data);
+    return tex;
 }
 
-void init_renderer(void){
-    const unsigned char *version = glGetString(GL_VERSION);
-    printf("opengl version:%s\n", version);
-    //print_all_gl_extensions();
-
-    /* Allocate and assign a Vertex Array Object to our handle */
-    glGenVertexArrays(1, &vertex_array_obj);
+void init_renderer(RenderBackend *backend){
+    Backend = backend;
 
-    /* Bind our Vertex Array Object as the current used object */
-    glBindVertexArray(vertex_array_obj);
+    Atlas.texture.id = create_texture_from_bitmap(NULL, ATLAS_SIZE, ATLAS_SIZE);
+    Atlas.texture.width  = ATLAS_SIZE;
+    Atlas.texture.height = ATLAS_SIZE;
 
-    glGenBuffers(1, &vertex_buffer_obj);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_obj);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexBuffer), NULL, GL_STREAM_DRAW); // Copy buffer
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));      // This only tell opengl what is what in
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texture_coord)); // the buffer!
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));    
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-
-    b32 result0 = create_shader_context(&TextureShader, "shaders/simple.vert", "shaders/simple.frag");
-    b32 result1 = create_shader_context(&PrimitiveShader, "shaders/primitive.vert", "shaders/primitive.frag");
-    assert(result0 && result1);
-
-    glViewport(0, 0, WWIDTH, WHEIGHT);
-    glActiveTexture(GL_TEXTURE0);
-    glDepthRange(0, 1);
-    glEnable(GL_BLEND);
-    glEnable(GL_LINE_SMOOTH);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
-    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
-
-    set_zero(&BatchList, sizeof(BatchList));
+    set_zero(&CommandList, sizeof(CommandList));
+    grow_command_arena(COMMAND_ARENA_START);
+    CommandList.uniforms = grow_array(NULL, 0, UNIFORMS_ARENA_START, sizeof(Uniforms));
+    CommandList.uniforms_capacity = UNIFORMS_ARENA_START;
     set_default_uniforms(&DrawContext.uniforms);
-
-    GLuint error;
-    while(error = glGetError(), error)
-        printf("Error:%x\n", error);
+    DrawContext.uniforms_index = -1;
+    DrawContext.layer = LAYER_SCENE;
 
     stbi_set_flip_vertically_on_load(true);
 }
@@ -417,45 +416,63 @@ void draw_rect(f32 x, f32 y, f32 w, f32 h, Vec4 color){
     draw_end();
 }
 
-static inline b32 draw_command_is_mergeable(const DrawCommand *current, const DrawCommand *new){
-    assert(new);
-    if(!current) return false;
+// Index of the current uniforms in CommandList, they rarely change so
+// the search only runs after set_uv_matrix or a flush
+static i32 current_uniforms_index(void){
+    T_DrawContext *context = &DrawContext;
+    if(context->uniforms_index >= 0) return context->uniforms_index;
 
-    b32 result = (
-        (current->type == new->type) &
-        (current->tex_id == new->tex_id) &
-        (current->shader_context == new->shader_context)
-    );
-    if(!result) return false;
-    
     // Note: Ensure all Uniforms are initialized to zero.
     // The undefined behavior of paddings can cause this memcmp to trigger!
-    return memcmp(&current->uniforms, &new->uniforms, sizeof(Uniforms)) == 0;
+    for(i32 i = 0; i < CommandList.uniforms_count; i++){
+        if(memcmp(&CommandList.uniforms[i], &context->uniforms, sizeof(Uniforms)) == 0)
+            return context->uniforms_index = i;
+    }
+    if(CommandList.uniforms_count >= CommandList.uniforms_capacity){
+        i32 capacity = CommandList.uniforms_capacity * 2;
+        assert(capacity <= UNIFORMS_MAX); // that many set_uv_matrix calls in one frame?
+        CommandList.uniforms = grow_array(CommandList.uniforms, CommandList.uniforms_count, capacity, sizeof(Uniforms));
+        CommandList.uniforms_capacity = capacity;
+    }
+    CommandList.uniforms[CommandList.uniforms_count] = context->uniforms;
+    return context->uniforms_index = CommandList.uniforms_count++;
 }
 
-static void enqueue_render_command(void){
-    const T_DrawContext *context = &DrawContext;
-    if(BatchList.count >= array_size(BatchList.batchs))
-        execute_draw_commands();
-
-    if(!draw_command_is_mergeable(BatchList.current, &context->command)){
-        BatchList.current  = BatchList.batchs + BatchList.count++;
-        *BatchList.current = context->command;
-    } else{
-        BatchList.current->vertices_count += context->command.vertices_count;
+static void enqueue_render_command(const DrawCommand *command){
+    if(CommandList.count >= CommandList.capacity){
+        assert(CommandList.capacity * 2 <= (1 << KEY_SEQUENCE_BITS));
+        grow_command_arena(CommandList.capacity * 2);
+        ArenaGrowCount++; // @Debug
     }
+    assert(command->tex_id < (1 << 16) && command->shader_context->sort_id < (1 << 6));
+    u64 key = ((u64)command->layer << KEY_LAYER_SHIFT) |
+              ((u64)command->shader_context->sort_id << KEY_SHADER_SHIFT) |
+              ((u64)command->type << KEY_TYPE_SHIFT) |
+              ((u64)current_uniforms_index() << KEY_UNIFORMS_SHIFT) |
+              ((u64)command->tex_id << KEY_TEXTURE_SHIFT) |
+              (u64)CommandList.count;
+    CommandList.keys[CommandList.count] = key;
+    CommandList.commands[CommandList.count++] = *command;
+}
+
+void set_layer(i32 layer){
+    assert(layer >= 0 && layer < LAYER_COUNT);
+    DrawContext.layer = layer;
 }
 
 void draw_begin(i32 primitive){
     T_DrawContext *context = &DrawContext;
     assert(!context->drawing);
     context->drawing = true;
-    context->texture_coord = Vec2(0, 0);
-    context->color = Vec4(0, 0, 0, 0);
+    context->texture_coord[0] = 0;
+    context->texture_coord[1] = 0;
+    context->color = 0;
+    context->command.first_vertex = VertexCount;
     context->command.vertices_count = 0;
     context->command.type = primitive;
     context->command.tex_id = 0;
     context->command.shader_context = &PrimitiveShader;
+    context->command.layer = context->layer;
 }
 
 void draw_end(void){
@@ -463,21 +480,21 @@ void draw_end(void){
     assert(context->drawing);
     assert(context->command.vertices_count % 3 == 0);
     FrameVertexCount += context->command.vertices_count; // @Debug
-    context->command.uniforms = context->uniforms;
-    enqueue_render_command();
+    enqueue_render_command(&context->command);
     context->drawing = false;
 }
 
 void set_color(Vec4 color){
     T_DrawContext *context = &DrawContext;
     assert(context->drawing);
-    context->color = color;
+    context->color = rgba_color(color).u;
 }
 
 void set_texture_coord(Vec2 coord){
     T_DrawContext *context = &DrawContext;
     assert(context->drawing);
-    context->texture_coord = coord;
+    context->texture_coord[0] = (u16)(clampf(coord.x, 0.0f, 1.0f) * 65535.0f + .5f);
+    context->texture_coord[1] = (u16)(clampf(coord.y, 0.0f, 1.0f) * 65535.0f + .5f);
 }
 
 void set_texture(u32 texture){
@@ -496,21 +513,21 @@ void set_vertex(Vec2 pos){
     T_DrawContext *context = &DrawContext;
     assert(context->drawing);
     
-    if(VertexCount >= array_size(VertexBuffer)){
-        execute_draw_commands();
-        assert(VertexCount < array_size(VertexBuffer)); // trying to draw something really big or forggot to call draw_end
+    if(VertexCount >= Backend->vertex_capacity){
+        i32 capacity = Backend->vertex_capacity * 2;
+        assert(capacity <= 1 << 24); // trying to draw something really big or forggot to call draw_end
+        Backend->grow_vertices(Backend, capacity, VertexCount);
+        ArenaGrowCount++; // @Debug
     }
 
+    // Mapped memory, write the whole vertex at once
     context->command.vertices_count++;
-    Vertex *current = &VertexBuffer[VertexCount++];
-    current->position[0] = pos.x;
-    current->position[1] = pos.y;
-    current->texture_coord[0] = context->texture_coord.x;
-    current->texture_coord[1] = context->texture_coord.y;
-    current->color[0] = context->color.x;
-    current->color[1] = context->color.y;
-    current->color[2] = context->color.z;
-    current->color[3] = context->color.w;
+    Vertex *current = Backend->vertices + VertexCount++;
+    *current = (Vertex){
+        .position = {(i16)roundf(pos.x), (i16)roundf(pos.y)},
+        .texture_coord = {context->texture_coord[0], context->texture_coord[1]},
+        .color = context->color,
+    };
 }
 
 void draw_texture(float x, float y, f32 scale, TextureInfo tex){
@@ -525,7 +542,7 @@ void draw_texture(float x, float y, f32 scale, TextureInfo tex){
     draw_end();
 }
 
-void draw_sprite(float x0, float y0, f32 scale, Vec4 color, Sprite sprite){
+static void draw_sprite_vertices(float x0, float y0, f32 scale, Vec4 color, Sprite sprite){
     f32 x1 = x0 + sprite.w * scale;
     f32 y1 = y0 + sprite.h * scale;
 
@@ -560,14 +577,42 @@ void draw_sprite(float x0, float y0, f32 scale, Vec4 color, Sprite sprite){
     draw_end();
 }
 
+// Unscaled sprites (tiles and glyphs, so nearly everything) are one
+// 16 byte instance instead of six vertices
+void draw_sprite(float x0, float y0, f32 scale, Vec4 color, Sprite sprite){
+    if(scale != 1.0f){
+        draw_sprite_vertices(x0, y0, scale, color, sprite);
+        return;
+    }
+
+    T_DrawContext *context = &DrawContext;
+    assert(!context->drawing);
+    FrameSpriteCount++; // @Debug
+
+    DrawCommand command = {
+        .type = DRAW_SPRITE,
+        .tex_id = sprite.atlas.id,
+        .shader_context = &SpriteShader,
+        .layer = context->layer,
+        .instance = {
+            .position = {(i16)roundf(x0), (i16)roundf(y0)},
+            .atlas_rect = {(u16)sprite.x, (u16)sprite.y, (u16)sprite.w, (u16)sprite.h},
+            .color = rgba_color(color).u,
+        },
+    };
+    enqueue_render_command(&command);
+}
+
 void set_uv_matrix(const float *matrix3x3){
     T_DrawContext *context = &DrawContext;
     memcpy(context->uniforms.uv_matrix, matrix3x3, sizeof(context->uniforms.uv_matrix));
+    context->uniforms_index = -1;
 }
 
+// Clears when the frame is submitted, before anything is drawn
 void clear_screen(Vec4 color){
-    glClearColor(color.x, color.y, color.z, color.w);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawContext.clear = true;
+    DrawContext.clear_color = rgba_color(color).u;
 }
 
 Vec4 brightness(Vec4 color, f32 scaler){
@@ -586,10 +631,10 @@ Vec4 vec4_color(u32 hex){
 
 Color rgba_color(Vec4 color){
     Color c = {
-        .r = (u8)(color.x * 255.0f + .5f),
-        .g = (u8)(color.y * 255.0f + .5f),
-        .b = (u8)(color.z * 255.0f + .5f),
-        .a = (u8)(color.w * 255.0f + .5f),
+        .r = (u8)(clampf(color.x, 0.0f, 1.0f) * 255.0f + .5f),
+        .g = (u8)(clampf(color.y, 0.0f, 1.0f) * 255.0f + .5f),
+        .b = (u8)(clampf(color.z, 0.0f, 1.0f) * 255.0f + .5f),
+        .a = (u8)(clampf(color.w, 0.0f, 1.0f) * 255.0f + .5f),
     };
     return c;
 }
\ No newline at end of file
@@ -1,18 +1,21 @@
 #pragma once
 
+#include "render_backend.h"
+
+// Which shaders a draw uses, the backend owns the programs
 typedef struct S_ShaderContext {
-    u32 program_id;
-    struct{
-        struct FileInfo *vert_file_info, *frag_file_info;
-    }debug_info;
+    i32 sort_id; // draw command sort key bits, never changes
+    b32 textured;
+    const char *vert_file, *frag_file;
 }ShaderContext;
 
 extern struct S_ShaderContext TextureShader;
 extern struct S_ShaderContext PrimitiveShader;
+extern struct S_ShaderContext SpriteShader;
 
 extern const Vec4 White_v4, Black_v4, Red_v4, Green_v4, Blue_v4, Yellow_v4;
 
-void init_renderer(void);
+void init_renderer(RenderBackend *backend);
 u32 create_texture_from_bitmap(u8 *data, i32 width, i32 height);
 TextureInfo load_texture(const char *file_name);
 void execute_draw_commands(void);
@@ -23,11 +26,27 @@ typedef struct{
     TextureInfo atlas;
 }Sprite;
 
-enum DrawPrimitiveTypes{
-    DRAW_NONE,
-    DRAW_TRIANGLE,
+// All sprite sheets and fonts share one texture, see atlas_add_bitmap
+b32 atlas_add_bitmap(Sprite *sprite, const u8 *data, i32 width, i32 height);
+b32 load_sprite_sheet(Sprite *sheet, const char *file_name);
+
+// Draws are sorted by layer, then by state (shader, uniforms, texture).
+// Only draws with the same state keep their order inside a layer, so
+// anything that has to cover something drawn with other state goes to a
+// higher layer. The layer sticks until changed.
+enum DrawLayers{
+    LAYER_BACKGROUND,
+    LAYER_SCENE,
+    LAYER_TEXT,
+    LAYER_OVERLAY,
+    LAYER_OVERLAY_TEXT,
+    LAYER_DEBUG,
+    LAYER_DEBUG_TEXT,
+    LAYER_COUNT,
 };
 
+void set_layer(i32 layer);
+
 void draw_begin(i32 primitive);
 void draw_end(void);
 void set_color(Vec4 color);
@@ -48,8 +67,10 @@ Color rgba_color(Vec4 color);
 
 // @Debug
 extern i32 FrameVertexCount;
+extern i32 FrameSpriteCount;
 extern i32 FrameDrawCallsCount;
 void show_rederer_debug_info(f32 x, f32 y);
+void reset_frame_stats(void);
 
 // Font
 
@@ -74,7 +95,7 @@ extern Font DebugFont; // @Debug
 extern Font *CurrentFont;
 
 void init_fonts(void);
-Font load_font(const char *name, i32 height_pixel_size);
+b32 load_font(Font *font, const char *name, i32 height_pixel_size);
 void set_font(Font *font);
 
 i32 draw_text(f32 x, f32 y, Vec4 color, const char *format, ...);
@@ -85,6 +106,6 @@ i32 count_text_width(const char *string);
 #define format_string_varargs(buffer, size, format) {\
         va_list _args;\
         va_start(_args, format);\
-        vsprintf_s(buffer, size, format, _args);\
+        vsnprintf(buffer, size, format, _args);\
         va_end(_args);\
-    }
\ No newline at end of file
+    }
@@ -0,0 +1,636 @@
+// OpenGL 3.3 backend for renderer.c: streams the frame's vertices and
+// sprite instances through mapped buffers, owns the shader programs and
+// the textures, and turns every RenderBatch into one draw call.
+
+#include <GL/glcorearb.h>
+#include "engine.h"
+#include "game.h"
+#include "renderer.h"
+#include "opengl_api.h"
+#include "file_watch.h"
+
+// Opengl reminders:
+// It is advised however, that you stick to powers-of-two for
+// texture sizes, unless you have a significant need to use arbitrary sizes.
+
+PFNGLCREATESHADERPROC  glCreateShader;
+PFNGLSHADERSOURCEPROC  glShaderSource;
+PFNGLCOMPILESHADERPROC glCompileShader;
+PFNGLGETSHADERIVPROC   glGetShaderiv;
+PFNGLCREATEPROGRAMPROC glCreateProgram;
+PFNGLLINKPROGRAMPROC   glLinkProgram;
+PFNGLGETPROGRAMIVPROC  glGetProgramiv;
+PFNGLUSEPROGRAMPROC    glUseProgram;
+PFNGLDELETEPROGRAMPROC glDeleteProgram;
+PFNGLATTACHSHADERPROC  glAttachShader;
+PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
+PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog;
+PFNGLGENBUFFERSPROC    glGenBuffers;
+PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
+PFNGLBINDBUFFERPROC glBindBuffer;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
+PFNGLBUFFERDATAPROC glBufferData;
+PFNGLBUFFERSUBDATAPROC glBufferSubData;
+PFNGLGETBUFFERSUBDATAPROC glGetBufferSubData;
+PFNGLUNIFORM3FVPROC glUniform3fv;
+PFNGLUNIFORM2FPROC glUniform2f;
+PFNGLUNIFORM1IPROC glUniform1i;
+PFNGLUNIFORM1IVPROC glUniform1iv;
+PFNGLDELETESHADERPROC glDeleteShader;
+PFNGLBINDATTRIBLOCATIONPROC glBindAttribLocation;
+PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv;
+PFNGLUNIFORMMATRIX3FVPROC glUniformMatrix3fv;
+PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+PFNGLACTIVETEXTUREPROC glActiveTexture;
+PFNGLBLENDEQUATIONSEPARATEPROC glBlendEquationSeparate;
+PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
+PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstanced;
+PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisor;
+PFNGLBUFFERSTORAGEPROC glBufferStorage; // Extension, NULL if missing
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+PFNGLFENCESYNCPROC glFenceSync;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+PFNGLDELETESYNCPROC glDeleteSync;
+PFNGLMULTIDRAWARRAYSPROC glMultiDrawArrays;
+PFNGLBINDTEXTUREUNITPROC glBindTextureUnit;
+PFNGLGETSTRINGIPROC glGetStringi;
+
+PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
+PFNGLVERTEXATTRIBIPOINTERPROC glVertexAttribIPointer;
+
+PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
+PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
+
+#define STREAM_REGIONS 3
+
+// Buffer the cpu writes vertices straight into. With ARB_buffer_storage
+// it's mapped once (persistent, coherent) and split in STREAM_REGIONS
+// regions: every flush draws from one region, fences it and moves to the
+// next, and a region is only written again after its fence passed. On
+// the render thread (gl_reserve_streams) the frontend moves on to the
+// next region at handoff, while the region before waits for its draws.
+// Without it there's a single region that is orphaned and mapped again
+// after every flush. Mappings are write only so drivers can hand out
+// write combined memory, stream_buffer_grow reads a half written region
+// back through glGetBufferSubData instead.
+typedef struct{
+    GLuint buffer;
+    GLsizeiptr region_size;
+    i32 region;
+    GLsync fences[STREAM_REGIONS];
+    u8 *base;  // all regions, persistent mapping only
+    u8 *write; // current region
+}StreamBuffer;
+
+static b32 PersistentMapping;
+
+static GLuint vertex_array_obj;
+static GLuint sprite_array_obj, sprite_quad_obj;
+
+static StreamBuffer VertexStream;
+static StreamBuffer InstanceStream;
+
+// glMultiDrawArrays arguments for one batch
+static GLint *MultiDrawFirst;
+static GLsizei *MultiDrawCount;
+static i32 MultiDrawCapacity;
+
+// GL side of a ShaderContext, by sort_id
+typedef struct{
+    u32 id;
+    // resolved once per link, -1 when the program doesn't use it
+    struct{
+        i32 ident_matrix, trans_matrix, texture_trans_matrix, sample_tex;
+    }locations;
+    // what the program has now, uploads are skipped when they match
+    Uniforms uploaded;
+    b32 uploaded_valid;
+    struct{
+        const char *vert_name, *frag_name; // inside shaders/, matched against the file watch
+    }debug_info;
+}ShaderProgram;
+
+#define SHADER_PROGRAMS_MAX 8
+static ShaderProgram ShaderPrograms[SHADER_PROGRAMS_MAX];
+
+static ShaderContext *const Shaders[] = {&TextureShader, &PrimitiveShader, &SpriteShader};
+
+// @Debug shader hot reload
+static FileWatch ShaderWatch;
+static b32 ShaderWatchRunning;
+
+static RenderBackend GLBackend;
+
+// What's bound on the context right now, all binds in this file go
+// through the gl_* wrappers so redundant calls can be skipped
+static struct{
+    u32 program;
+    u32 texture;
+    u32 vertex_array;
+    b32 blend;
+}GLState;
+
+static inline void gl_use_program(u32 program){
+    if(GLState.program == program) return;
+    glUseProgram(program);
+    GLState.program = program;
+}
+
+static inline void gl_bind_texture(u32 texture){
+    if(GLState.texture == texture) return;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLState.texture = texture;
+}
+
+static inline void gl_bind_vertex_array(u32 vertex_array){
+    if(GLState.vertex_array == vertex_array) return;
+    glBindVertexArray(vertex_array);
+    GLState.vertex_array = vertex_array;
+}
+
+static inline void gl_set_blend(b32 enable){
+    if(GLState.blend == enable) return;
+    if(enable) glEnable(GL_BLEND);
+    else       glDisable(GL_BLEND);
+    GLState.blend = enable;
+}
+
+static GLuint create_program(const char *vert_path, const char *frag_path);
+static b32 compile_shader(GLuint shader);
+
+static inline ShaderProgram *shader_program(const ShaderContext *context){
+    assert(context->sort_id > 0 && context->sort_id < SHADER_PROGRAMS_MAX);
+    return &ShaderPrograms[context->sort_id];
+}
+
+static void set_shader_program(ShaderProgram *shader, u32 program){
+    shader->id = program;
+    shader->locations.ident_matrix = glGetUniformLocation(program, "ident_matrix");
+    shader->locations.trans_matrix = glGetUniformLocation(program, "trans_matrix");
+    shader->locations.texture_trans_matrix = glGetUniformLocation(program, "texture_trans_matrix");
+    shader->locations.sample_tex = glGetUniformLocation(program, "sample_tex");
+    shader->uploaded_valid = false;
+}
+
+static void stream_buffer_map(StreamBuffer *stream){
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    glBufferData(GL_ARRAY_BUFFER, stream->region_size, NULL, GL_STREAM_DRAW); // orphan
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    stream->write = glMapBufferRange(GL_ARRAY_BUFFER, 0, stream->region_size, flags);
+    assert(stream->write);
+}
+
+static void stream_buffer_init(StreamBuffer *stream, GLsizeiptr region_size){
+    set_zero(stream, sizeof(*stream));
+    stream->region_size = region_size;
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+
+    if(PersistentMapping){
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, region_size * STREAM_REGIONS, NULL, flags);
+        stream->base  = glMapBufferRange(GL_ARRAY_BUFFER, 0, region_size * STREAM_REGIONS, flags);
+        stream->write = stream->base;
+        assert(stream->base);
+    } else{
+        stream_buffer_map(stream);
+    }
+}
+
+static void stream_buffer_free(StreamBuffer *stream){
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    if(PersistentMapping || stream->write) glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &stream->buffer); // the driver keeps it alive for draws still in flight
+    for(i32 i = 0; i < STREAM_REGIONS; i++){
+        if(stream->fences[i]) glDeleteSync(stream->fences[i]);
+    }
+    set_zero(stream, sizeof(*stream));
+}
+
+// Byte offset of a region, for draws and attribute pointers
+static inline size_t stream_buffer_offset(const StreamBuffer *stream, i32 region){
+    return (size_t)region * stream->region_size;
+}
+
+// The region a pointer into the mapping is in
+static inline i32 stream_buffer_region_of(const StreamBuffer *stream, const void *pointer){
+    if(!PersistentMapping) return 0;
+    return (i32)(((const u8*)pointer - stream->base) / stream->region_size);
+}
+
+// Call before drawing from the current region
+static void stream_buffer_unmap(StreamBuffer *stream){
+    if(PersistentMapping) return; // coherent, nothing to flush
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    stream->write = NULL;
+}
+
+// New buffer with bigger regions, the first used bytes of the current
+// region come along. Only grows between flushes, so nothing was drawn from
+// the current region yet. The mapping can't be read, the used bytes come
+// back through a staging copy, grows are rare.
+static void stream_buffer_grow(StreamBuffer *stream, GLsizeiptr region_size, GLsizeiptr used){
+    void *staging = NULL;
+    if(used){
+        staging = os_memory_alloc(used);
+        assert(staging);
+        stream_buffer_unmap(stream);
+        glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, stream_buffer_offset(stream, stream->region), used, staging);
+    }
+
+    StreamBuffer grown;
+    stream_buffer_init(&grown, region_size);
+    if(staging){
+        memcpy(grown.write, staging, used);
+        os_memory_free(staging);
+    }
+    stream_buffer_free(stream);
+    *stream = grown;
+}
+
+// Call after the draws from region were issued
+static void stream_buffer_fence(StreamBuffer *stream, i32 region){
+    if(!PersistentMapping) return;
+    if(stream->fences[region]) glDeleteSync(stream->fences[region]);
+    stream->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Moves writes on to the next region, once the gpu is done with it
+static void stream_buffer_next(StreamBuffer *stream){
+    if(!PersistentMapping){
+        stream_buffer_map(stream);
+        return;
+    }
+
+    stream->region = (stream->region + 1) % STREAM_REGIONS;
+    GLsync fence = stream->fences[stream->region];
+    if(fence){
+        // Only waits when the gpu is STREAM_REGIONS flushes behind
+        while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+    stream->write = stream->base + stream_buffer_offset(stream, stream->region);
+}
+
+static b32 has_gl_extension(const char *name){
+    i32 count;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for(i32 i = 0; i < count; i++){
+        if(strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Expects sprite_array_obj bound
+static void set_sprite_instance_attributes(i32 region, i32 first_instance){
+    size_t base = stream_buffer_offset(&InstanceStream, region) + sizeof(SpriteInstance) * first_instance;
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceStream.buffer);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(SpriteInstance), (void*)(base + offsetof(SpriteInstance, position)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(SpriteInstance), (void*)(base + offsetof(SpriteInstance, atlas_rect)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance), (void*)(base + offsetof(SpriteInstance, color)));
+}
+
+// Vertex layout of vertex_array_obj, again whenever the stream buffer changes
+static void set_vertex_attributes(void){
+    gl_bind_vertex_array(vertex_array_obj);
+    glBindBuffer(GL_ARRAY_BUFFER, VertexStream.buffer);
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));               // This only tell opengl what is what in
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, texture_coord)); // the buffer!
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+}
+
+// Points the backend at the current stream regions, after they moved
+static void update_backend_streams(void){
+    GLBackend.vertices = (Vertex*)VertexStream.write;
+    GLBackend.vertex_capacity = (i32)(VertexStream.region_size / sizeof(Vertex));
+    GLBackend.instances = (SpriteInstance*)InstanceStream.write;
+    GLBackend.instance_capacity = (i32)(InstanceStream.region_size / sizeof(SpriteInstance));
+}
+
+static void gl_grow_vertices(RenderBackend *backend, i32 capacity, i32 used){
+    (void)backend;
+    stream_buffer_grow(&VertexStream, sizeof(Vertex) * capacity, sizeof(Vertex) * used);
+    set_vertex_attributes();
+    update_backend_streams();
+}
+
+static void gl_grow_instances(RenderBackend *backend, i32 capacity){
+    (void)backend;
+    stream_buffer_grow(&InstanceStream, sizeof(SpriteInstance) * capacity, 0);
+    update_backend_streams();
+}
+
+// Persistent mapping only, the frame in the old regions is drawn from
+// there when it's submitted
+static void gl_reserve_streams(RenderBackend *backend){
+    (void)backend;
+    stream_buffer_next(&VertexStream);
+    stream_buffer_next(&InstanceStream);
+    update_backend_streams();
+}
+
+static u32 gl_create_texture(RenderBackend *backend, const u8 *data, i32 width, i32 height){
+    (void)backend;
+    u32 id;
+    glGenTextures(1, &id);
+    gl_bind_texture(id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl_bind_texture(0);
+    return id;
+}
+
+static void gl_update_texture(RenderBackend *backend, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data){
+    (void)backend;
+    gl_bind_texture(texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+}
+
+static u32 get_gl_mode(u32 renderer_type){
+    renderer_type -= 1;
+    assert(renderer_type >= 0);
+    u32 lookup_table[] = {GL_TRIANGLES};
+    assert(renderer_type < array_size(lookup_table));
+    return lookup_table[renderer_type];
+}
+
+// Expects the program in use
+static void update_shader_uniforms(ShaderProgram *shader, const Uniforms *uniforms){
+    if(shader->uploaded_valid && memcmp(&shader->uploaded, uniforms, sizeof(Uniforms)) == 0)
+        return;
+
+    glUniformMatrix4fv(shader->locations.ident_matrix, 1, GL_TRUE, (float*)uniforms->ident_matrix);
+    glUniformMatrix4fv(shader->locations.trans_matrix, 1, GL_TRUE, (float*)uniforms->translation_matrix);
+    glUniformMatrix3fv(shader->locations.texture_trans_matrix, 1, GL_TRUE, (float*)uniforms->uv_matrix);
+    glUniform1i(shader->locations.sample_tex, uniforms->sample_tex);
+
+    shader->uploaded = *uniforms;
+    shader->uploaded_valid = true;
+}
+
+// @Debug Hot reload. The watch thread queues the names of the files saved
+// in shaders/ and this drains them once per frame, so when nothing was
+// saved it's one check of an empty queue.
+static void reload_changed_shaders(void){
+    if(!ShaderWatchRunning) return;
+
+    char name[FILE_WATCH_NAME_SIZE];
+    while(file_watch_next(&ShaderWatch, name, sizeof(name))){
+        for(i32 i = 0; i < array_size(Shaders); i++){
+            ShaderProgram *shader = shader_program(Shaders[i]);
+            if(strcmp(name, shader->debug_info.vert_name) != 0 && strcmp(name, shader->debug_info.frag_name) != 0)
+                continue;
+
+            printf("reloading %s\n", name);
+            // by path, editors that save with a rename leave any open handle on the old file
+            GLuint new_program = create_program(Shaders[i]->vert_file, Shaders[i]->frag_file);
+            if(new_program){
+                if(GLState.program == shader->id) GLState.program = 0;
+                glDeleteProgram(shader->id);
+                set_shader_program(shader, new_program);
+            }
+        }
+    }
+}
+
+// Expects the frame in stream regions, the current ones or the ones
+// before a gl_reserve_streams
+static void gl_submit_frame(RenderBackend *backend, const RenderFrame *frame){
+    (void)backend;
+    reload_changed_shaders();
+
+    if(frame->clear){
+        Color c = {.u = frame->clear_color};
+        glClearColor(c.r / 255.0f, c.g / 255.0f, c.b / 255.0f, c.a / 255.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    if(frame->range_count > MultiDrawCapacity){
+        i32 capacity = MAX(MultiDrawCapacity, 64);
+        while(capacity < frame->range_count) capacity *= 2;
+        if(MultiDrawFirst){
+            os_memory_free(MultiDrawFirst);
+            os_memory_free(MultiDrawCount);
+        }
+        MultiDrawFirst = os_memory_alloc(sizeof(GLint) * capacity);
+        MultiDrawCount = os_memory_alloc(sizeof(GLsizei) * capacity);
+        assert(MultiDrawFirst && MultiDrawCount);
+        MultiDrawCapacity = capacity;
+    }
+
+    i32 vertex_region   = stream_buffer_region_of(&VertexStream, frame->vertices);
+    i32 instance_region = stream_buffer_region_of(&InstanceStream, frame->instances);
+    stream_buffer_unmap(&VertexStream);
+    stream_buffer_unmap(&InstanceStream);
+    i32 region_first_vertex = (i32)(stream_buffer_offset(&VertexStream, vertex_region) / sizeof(Vertex));
+
+    for(i32 i = 0; i < frame->batch_count; i++){
+        const RenderBatch *batch = &frame->batches[i];
+        ShaderProgram *shader = shader_program(batch->shader);
+        gl_use_program(shader->id);
+        update_shader_uniforms(shader, batch->uniforms);
+        if(batch->texture) gl_bind_texture(batch->texture); // untextured draws keep the atlas bound
+
+        if(batch->type == DRAW_SPRITE){
+            // no base instance in 3.3, point the instance attributes at this batch instead
+            gl_bind_vertex_array(sprite_array_obj);
+            set_sprite_instance_attributes(instance_region, batch->first);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, batch->count);
+        } else{
+            for(i32 r = 0; r < batch->count; r++){
+                const VertexRange *range = &frame->ranges[batch->first + r];
+                MultiDrawFirst[r] = region_first_vertex + range->first;
+                MultiDrawCount[r] = range->count;
+            }
+            gl_bind_vertex_array(vertex_array_obj);
+            u32 gl_mode = get_gl_mode(batch->type);
+            if(batch->count == 1) glDrawArrays(gl_mode, MultiDrawFirst[0], MultiDrawCount[0]);
+            else                  glMultiDrawArrays(gl_mode, MultiDrawFirst, MultiDrawCount, batch->count);
+        }
+    }
+
+    stream_buffer_fence(&VertexStream, vertex_region);
+    stream_buffer_fence(&InstanceStream, instance_region);
+    // after a reserve the frontend is already writing further on
+    if(vertex_region == VertexStream.region)     stream_buffer_next(&VertexStream);
+    if(instance_region == InstanceStream.region) stream_buffer_next(&InstanceStream);
+    update_backend_streams();
+}
+
+static GLuint create_program(const char *vert_path, const char *frag_path){
+    i32 result;
+    char error_buffer[200];
+    i32 error_string_size;
+
+    // a file can be missing for a moment while an editor saves it
+    i32 vert_size, frag_size;
+    char *vert_data = (char*)os_read_whole_file(vert_path, &vert_size);
+    char *frag_data = (char*)os_read_whole_file(frag_path, &frag_size);
+    if(!vert_data || !frag_data){
+        if(vert_data) os_memory_free(vert_data);
+        if(frag_data) os_memory_free(frag_data);
+        return 0;
+    }
+
+    GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
+    GLuint vert = glCreateShader(GL_VERTEX_SHADER);
+
+    glShaderSource(frag, 1, &frag_data, &frag_size);
+    glShaderSource(vert, 1, &vert_data, &vert_size);
+
+    os_memory_free(vert_data);
+    os_memory_free(frag_data);
+
+    if(!compile_shader(frag) || !compile_shader(vert))
+         return 0;
+
+    GLuint program = glCreateProgram();
+
+    glAttachShader(program, vert);
+    glAttachShader(program, frag);
+    glGetProgramiv(program, GL_ATTACHED_SHADERS, &result);
+    assert(result == 2);
+
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &result);
+    glGetProgramInfoLog(program, sizeof(error_buffer), &error_string_size, error_buffer);
+    printf("Link:\n%s\n", error_buffer);
+    if(!result) return 0;
+
+    glDeleteShader(frag);
+    glDeleteShader(vert);
+
+    return program;
+}
+
+static b32 compile_shader(GLuint shader){
+    char error_buffer[400];
+    i32 error_string_size, result;
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+    glGetShaderInfoLog(shader, sizeof(error_buffer), &error_string_size, error_buffer);
+    printf("Shader Compilation:\n%s", error_buffer);
+    return result;
+}
+
+static const char *file_base_name(const char *path){
+    const char *name = path;
+    for(const char *at = path; *at; at++)
+        if(*at == '/' || *at == '\\') name = at + 1;
+    return name;
+}
+
+static b32 create_shader_program(ShaderContext *context){
+    GLuint program = create_program(context->vert_file, context->frag_file);
+    if(!program)
+        return false;
+
+    ShaderProgram *shader = shader_program(context);
+    set_shader_program(shader, program);
+    // Debug
+    shader->debug_info.vert_name = file_base_name(context->vert_file);
+    shader->debug_info.frag_name = file_base_name(context->frag_file);
+
+    return true;
+}
+
+static void print_all_gl_extensions(void){
+    i32 num;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &num);
+    printf("max texture size:%dx%d\n", num / 2, num / 2);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num);
+    printf("extension number:%d\n", num);
+    for(i32 i = 0; i < num; i++){
+        printf(" %s\n", glGetStringi(GL_EXTENSIONS, i));
+    }
+}
+
+RenderBackend *gl_backend_create(void){
+    const unsigned char *version = glGetString(GL_VERSION);
+    printf("opengl version:%s\n", version);
+    //print_all_gl_extensions();
+
+    /* Allocate and assign a Vertex Array Object to our handle */
+    glGenVertexArrays(1, &vertex_array_obj);
+
+    /* Bind our Vertex Array Object as the current used object */
+    gl_bind_vertex_array(vertex_array_obj);
+
+    i32 major, minor;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    PersistentMapping = glBufferStorage && (major > 4 || (major == 4 && minor >= 4) || has_gl_extension("GL_ARB_buffer_storage"));
+    printf("vertex streaming:%s\n", PersistentMapping? "persistent mapping" : "orphaning");
+
+    stream_buffer_init(&VertexStream, sizeof(Vertex) * VERTEX_ARENA_START);
+    set_vertex_attributes();
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    // Sprites: a static unit quad plus one SpriteInstance per sprite
+    const f32 unit_quad[6][2] = {
+        {0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f},
+        {1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f},
+    };
+    glGenVertexArrays(1, &sprite_array_obj);
+    gl_bind_vertex_array(sprite_array_obj);
+
+    glGenBuffers(1, &sprite_quad_obj);
+    glBindBuffer(GL_ARRAY_BUFFER, sprite_quad_obj);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unit_quad), unit_quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(unit_quad[0]), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    stream_buffer_init(&InstanceStream, sizeof(SpriteInstance) * INSTANCE_ARENA_START);
+    set_sprite_instance_attributes(0, 0);
+    for(u32 i = 1; i <= 3; i++){
+        glVertexAttribDivisor(i, 1);
+        glEnableVertexAttribArray(i);
+    }
+
+    gl_bind_vertex_array(vertex_array_obj);
+
+    for(i32 i = 0; i < array_size(Shaders); i++){
+        b32 result = create_shader_program(Shaders[i]);
+        assert(result);
+    }
+
+    ShaderWatchRunning = file_watch_start(&ShaderWatch, "shaders");
+    if(!ShaderWatchRunning) printf("can't watch shaders/, no shader hot reload\n");
+
+    glViewport(0, 0, WWIDTH, WHEIGHT);
+    glActiveTexture(GL_TEXTURE0);
+    glDepthRange(0, 1);
+    gl_set_blend(true);
+    glEnable(GL_LINE_SMOOTH);
+    glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
+
+    GLuint error;
+    while(error = glGetError(), error)
+        printf("Error:%x\n", error);
+
+    GLBackend = (RenderBackend){
+        .name = "opengl",
+        .grow_vertices = gl_grow_vertices,
+        .grow_instances = gl_grow_instances,
+        .create_texture = gl_create_texture,
+        .update_texture = gl_update_texture,
+        .submit_frame = gl_submit_frame,
+        // orphaning has one mapping a buffer, frames on the render thread get copied then
+        .reserve_streams = PersistentMapping? gl_reserve_streams : NULL,
+    };
+    update_backend_streams();
+    return &GLBackend;
+}
@@ -0,0 +1,174 @@
+// Backend that draws nothing. Every submitted frame is copied out and
+// counted, so the cpu cost of building frames can be measured (and the
+// frames looked at) on a machine without a gpu, see bench_render.c.
+
+#include "basic.h"
+#include "engine.h"
+#include "render_backend.h"
+
+#include <string.h>
+
+typedef struct{
+    RenderBackend base; // first, the vtable gets this back as a RenderBackend
+    RenderCounters counters;
+    u32 texture_count;
+
+    // the other pair of streams, reserve_streams swaps them with base's
+    Vertex *spare_vertices;
+    i32 spare_vertex_capacity;
+    SpriteInstance *spare_instances;
+    i32 spare_instance_capacity;
+
+    // the last frame, its batches point at the copied uniforms
+    RenderFrame frame;
+    Vertex *vertices;
+    i32 vertices_capacity;
+    SpriteInstance *instances;
+    i32 instances_capacity;
+    VertexRange *ranges;
+    i32 ranges_capacity;
+    RenderBatch *batches;
+    Uniforms *uniforms;
+    i32 batches_capacity;
+}NullBackend;
+
+static NullBackend Null;
+
+// Contents aren't kept, everything in here is overwritten each frame
+static void *ensure_capacity(void *array, i32 *capacity, i32 count, size_t item_size){
+    if(count <= *capacity) return array;
+    i32 grown = MAX(*capacity, 64);
+    while(grown < count) grown *= 2;
+    if(array) os_memory_free(array);
+    array = os_memory_alloc(item_size * grown);
+    assert(array);
+    *capacity = grown;
+    return array;
+}
+
+static void null_grow_vertices(RenderBackend *backend, i32 capacity, i32 used){
+    NullBackend *null = (NullBackend*)backend;
+    Vertex *grown = os_memory_alloc(sizeof(Vertex) * capacity);
+    assert(grown);
+    memcpy(grown, backend->vertices, sizeof(Vertex) * used);
+    os_memory_free(backend->vertices);
+    backend->vertices = grown;
+    backend->vertex_capacity = capacity;
+    null->counters.grows++;
+}
+
+static void null_grow_instances(RenderBackend *backend, i32 capacity){
+    NullBackend *null = (NullBackend*)backend;
+    os_memory_free(backend->instances);
+    backend->instances = os_memory_alloc(sizeof(SpriteInstance) * capacity);
+    assert(backend->instances);
+    backend->instance_capacity = capacity;
+    null->counters.grows++;
+}
+
+static void null_reserve_streams(RenderBackend *backend){
+    NullBackend *null = (NullBackend*)backend;
+    Vertex *vertices = backend->vertices;
+    i32 vertex_capacity = backend->vertex_capacity;
+    SpriteInstance *instances = backend->instances;
+    i32 instance_capacity = backend->instance_capacity;
+    backend->vertices = null->spare_vertices;
+    backend->vertex_capacity = null->spare_vertex_capacity;
+    backend->instances = null->spare_instances;
+    backend->instance_capacity = null->spare_instance_capacity;
+    null->spare_vertices = vertices;
+    null->spare_vertex_capacity = vertex_capacity;
+    null->spare_instances = instances;
+    null->spare_instance_capacity = instance_capacity;
+}
+
+static u32 null_create_texture(RenderBackend *backend, const u8 *data, i32 width, i32 height){
+    NullBackend *null = (NullBackend*)backend;
+    null->counters.texture_creates++;
+    if(data) null->counters.texture_bytes += (u64)width * height * 4;
+    return ++null->texture_count;
+}
+
+static void null_update_texture(RenderBackend *backend, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data){
+    NullBackend *null = (NullBackend*)backend;
+    assert(texture && texture <= null->texture_count && data);
+    (void)x; (void)y;
+    null->counters.texture_updates++;
+    null->counters.texture_bytes += (u64)width * height * 4;
+}
+
+static void null_submit_frame(RenderBackend *backend, const RenderFrame *frame){
+    NullBackend *null = (NullBackend*)backend;
+    RenderCounters *counters = &null->counters;
+
+    null->vertices  = ensure_capacity(null->vertices, &null->vertices_capacity, frame->vertex_count, sizeof(Vertex));
+    null->instances = ensure_capacity(null->instances, &null->instances_capacity, frame->instance_count, sizeof(SpriteInstance));
+    null->ranges    = ensure_capacity(null->ranges, &null->ranges_capacity, frame->range_count, sizeof(VertexRange));
+    i32 uniforms_capacity = null->batches_capacity; // same size as batches
+    null->batches   = ensure_capacity(null->batches, &null->batches_capacity, frame->batch_count, sizeof(RenderBatch));
+    null->uniforms  = ensure_capacity(null->uniforms, &uniforms_capacity, frame->batch_count, sizeof(Uniforms));
+
+    memcpy(null->vertices, frame->vertices, sizeof(Vertex) * frame->vertex_count);
+    memcpy(null->instances, frame->instances, sizeof(SpriteInstance) * frame->instance_count);
+    memcpy(null->ranges, frame->ranges, sizeof(VertexRange) * frame->range_count);
+
+    const RenderBatch *previous = NULL;
+    for(i32 i = 0; i < frame->batch_count; i++){
+        const RenderBatch *batch = &frame->batches[i];
+        if(!previous || previous->shader != batch->shader || previous->texture != batch->texture ||
+           memcmp(previous->uniforms, batch->uniforms, sizeof(Uniforms)) != 0)
+            counters->state_changes++;
+        previous = batch;
+
+        null->uniforms[i] = *batch->uniforms;
+        null->batches[i] = *batch;
+        null->batches[i].uniforms = &null->uniforms[i];
+    }
+
+    null->frame = *frame;
+    null->frame.vertices  = null->vertices;
+    null->frame.instances = null->instances;
+    null->frame.ranges    = null->ranges;
+    null->frame.batches   = null->batches;
+
+    counters->frames++;
+    counters->batches += frame->batch_count;
+    counters->vertices += frame->vertex_count;
+    counters->vertex_bytes += sizeof(Vertex) * frame->vertex_count;
+    counters->instances += frame->instance_count;
+    counters->instance_bytes += sizeof(SpriteInstance) * frame->instance_count;
+    counters->ranges += frame->range_count;
+}
+
+RenderBackend *null_backend_create(void){
+    set_zero(&Null, sizeof(Null));
+    Null.base = (RenderBackend){
+        .name = "null",
+        .vertices = os_memory_alloc(sizeof(Vertex) * VERTEX_ARENA_START),
+        .vertex_capacity = VERTEX_ARENA_START,
+        .instances = os_memory_alloc(sizeof(SpriteInstance) * INSTANCE_ARENA_START),
+        .instance_capacity = INSTANCE_ARENA_START,
+        .grow_vertices = null_grow_vertices,
+        .grow_instances = null_grow_instances,
+        .create_texture = null_create_texture,
+        .update_texture = null_update_texture,
+        .submit_frame = null_submit_frame,
+        .reserve_streams = null_reserve_streams,
+    };
+    Null.spare_vertices = os_memory_alloc(sizeof(Vertex) * VERTEX_ARENA_START);
+    Null.spare_vertex_capacity = VERTEX_ARENA_START;
+    Null.spare_instances = os_memory_alloc(sizeof(SpriteInstance) * INSTANCE_ARENA_START);
+    Null.spare_instance_capacity = INSTANCE_ARENA_START;
+    assert(Null.base.vertices && Null.base.instances && Null.spare_vertices && Null.spare_instances);
+    return &Null.base;
+}
+
+const RenderCounters *null_backend_counters(RenderBackend *backend){
+    assert(backend == &Null.base);
+    return &Null.counters;
+}
+
+const RenderFrame *null_backend_last_frame(RenderBackend *backend){
+    assert(backend == &Null.base);
+    return &Null.frame;
+}
@@ -0,0 +1,63 @@
+// Backend that draws with raster.c into the Raster it was made with, for
+// rendering frames on machines without a gpu (golden_frames.c). The
+// streams are plain arrays, the frame is drawn when it's submitted.
+
+#include "basic.h"
+#include "raster.h"
+
+#include <string.h>
+
+typedef struct{
+    RenderBackend base; // first, the vtable gets this back as a RenderBackend
+    Raster *raster;
+}RasterBackend;
+
+static RasterBackend RasterTarget;
+
+static void raster_grow_vertices(RenderBackend *backend, i32 capacity, i32 used){
+    Vertex *grown = malloc(sizeof(Vertex) * capacity);
+    assert(grown);
+    memcpy(grown, backend->vertices, sizeof(Vertex) * used);
+    free(backend->vertices);
+    backend->vertices = grown;
+    backend->vertex_capacity = capacity;
+}
+
+static void raster_grow_instances(RenderBackend *backend, i32 capacity){
+    free(backend->instances);
+    backend->instances = malloc(sizeof(SpriteInstance) * capacity);
+    assert(backend->instances);
+    backend->instance_capacity = capacity;
+}
+
+static u32 raster_backend_create_texture(RenderBackend *backend, const u8 *data, i32 width, i32 height){
+    return raster_create_texture(((RasterBackend*)backend)->raster, data, width, height);
+}
+
+static void raster_backend_update_texture(RenderBackend *backend, u32 texture, i32 x, i32 y, i32 width, i32 height, const u8 *data){
+    raster_update_texture(((RasterBackend*)backend)->raster, texture, x, y, width, height, data);
+}
+
+static void raster_submit_frame(RenderBackend *backend, const RenderFrame *frame){
+    raster_draw_frame(((RasterBackend*)backend)->raster, frame);
+}
+
+RenderBackend *raster_backend_create(Raster *raster){
+    RasterTarget = (RasterBackend){
+        .base = {
+            .name = "raster",
+            .vertices = malloc(sizeof(Vertex) * VERTEX_ARENA_START),
+            .vertex_capacity = VERTEX_ARENA_START,
+            .instances = malloc(sizeof(SpriteInstance) * INSTANCE_ARENA_START),
+            .instance_capacity = INSTANCE_ARENA_START,
+            .grow_vertices = raster_grow_vertices,
+            .grow_instances = raster_grow_instances,
+            .create_texture = raster_backend_create_texture,
+            .update_texture = raster_backend_update_texture,
+            .submit_frame = raster_submit_frame,
+        },
+        .raster = raster,
+    };
+    assert(RasterTarget.base.vertices && RasterTarget.base.instances);
+    return &RasterTarget.base;
+}
@@ -0,0 +1,109 @@
+#include "basic.h"
+#include "simulation.h"
+#include "replay.h"
+
+#include <string.h>
+
+// Must be called right after sim_init, before the first step
+void replay_begin(Replay *replay, const SimState *state, u16 *runs, i32 run_capacity){
+    set_zero(replay, sizeof(*replay));
+    replay->header.magic   = REPLAY_MAGIC;
+    replay->header.version = REPLAY_VERSION;
+    replay->header.seed    = state->seed;
+    replay->header.board   = state->grid;
+    replay->runs = runs;
+    replay->run_capacity = run_capacity;
+}
+
+// Returns false once the run buffer is full, the tick is not recorded
+b32 replay_record(Replay *replay, u32 input_bits){
+    ReplayHeader *header = &replay->header;
+    assert((input_bits & ~REPLAY_INPUT_MASK) == 0);
+
+    if(header->run_count > 0){
+        u16 *last = &replay->runs[header->run_count - 1];
+        i32 length = (*last >> REPLAY_INPUT_BITS) + 1;
+        if((u32)(*last & REPLAY_INPUT_MASK) == input_bits && length < REPLAY_MAX_RUN){
+            *last += 1 << REPLAY_INPUT_BITS;
+            header->tick_count++;
+            return true;
+        }
+    }
+
+    if(header->run_count >= replay->run_capacity)
+        return false;
+    replay->runs[header->run_count++] = (u16)input_bits;
+    header->tick_count++;
+    return true;
+}
+
+void replay_start_playback(const Replay *replay, SimState *state){
+    sim_init(state, replay->header.seed);
+    sim_set_board(state, &replay->header.board);
+}
+
+// Returns false when the recording is over
+b32 replay_next_input(Replay *replay, u32 *input_bits){
+    if(replay->run_index >= replay->header.run_count)
+        return false;
+
+    u16 run = replay->runs[replay->run_index];
+    *input_bits = run & REPLAY_INPUT_MASK;
+    if(++replay->run_tick > (run >> REPLAY_INPUT_BITS)){
+        replay->run_tick = 0;
+        replay->run_index++;
+    }
+    return true;
+}
+
+// Replays are recorded in memory, run_count can't get near the i32 limit
+i32 replay_encoded_size(const Replay *replay){
+    i64 bytes = (i64)sizeof(ReplayHeader) + (i64)replay->header.run_count * (i64)sizeof(u16);
+    assert(bytes <= MAXi32);
+    return (i32)bytes;
+}
+
+// Returns the bytes written or 0 if the buffer is too small
+i32 replay_encode(const Replay *replay, void *buffer, i32 size){
+    i32 bytes = replay_encoded_size(replay);
+    if(size < bytes) return 0;
+    u8 *out = buffer;
+    memcpy(out, &replay->header, sizeof(ReplayHeader));
+    memcpy(out + sizeof(ReplayHeader), replay->runs, replay->header.run_count * sizeof(u16));
+    return bytes;
+}
+
+// Replays come from bug reports, so the board is checked before the sim
+// indexes colors with it or relies on the walls for collision
+static b32 board_is_valid(const Board *board){
+    for(i32 y = 0; y < GridH; y++){
+        if((board->rows[y] & GridWallMask) != GridWallMask) return false;
+        for(i32 x = 0; x < GridW; x++){
+            u8 color = board->colors[y][x];
+            b32 filled = (board->rows[y] >> (x + GridPad)) & 1;
+            if(color > PIECE_COUNT || (color != 0) != filled) return false;
+        }
+    }
+    return true;
+}
+
+// The runs keep pointing into data, it has to outlive the replay
+b32 replay_decode(Replay *replay, void *data, i32 size){
+    set_zero(replay, sizeof(*replay));
+    if(size < (i32)sizeof(ReplayHeader)) return false;
+
+    memcpy(&replay->header, data, sizeof(ReplayHeader));
+    const ReplayHeader *header = &replay->header;
+    if(header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION)
+        return false;
+    // in size_t, a crafted run_count would overflow the multiply in i32
+    if(header->run_count < 0 || (size_t)header->run_count > (size - sizeof(ReplayHeader)) / sizeof(u16))
+        return false;
+    if(!board_is_valid(&header->board))
+        return false;
+    board_update_counters(&replay->header.board); // the stored ones aren't trusted
+
+    replay->runs = (u16*)((u8*)data + sizeof(ReplayHeader));
+    replay->run_capacity = header->run_count;
+    return true;
+}
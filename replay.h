@@ -0,0 +1,43 @@
+#pragma once
+
+// Per tick input recording for the simulation. Inputs are stored as runs
+// of identical ticks packed in a u16 each, which together with the seed
+// and the starting board is enough to replay a game bit for bit.
+
+#include "basic.h"
+#include "simulation.h"
+
+#define REPLAY_MAGIC   0x4c505254 // "TRPL"
+#define REPLAY_VERSION 2
+
+#define REPLAY_INPUT_BITS 5
+#define REPLAY_INPUT_MASK ((1 << REPLAY_INPUT_BITS) - 1)
+#define REPLAY_MAX_RUN    (1 << (16 - REPLAY_INPUT_BITS))
+
+typedef struct{
+    u32 magic;
+    u32 version;
+    u64 seed;
+    i32 tick_count;
+    i32 run_count;
+    Board board; // grid the game started with
+}ReplayHeader;
+
+typedef struct{
+    ReplayHeader header;
+    i32 run_capacity;
+    u16 *runs; // (run length - 1) << REPLAY_INPUT_BITS | input bits
+
+    // playback cursor
+    i32 run_index;
+    i32 run_tick;
+}Replay;
+
+void replay_begin(Replay *replay, const SimState *state, u16 *runs, i32 run_capacity);
+b32 replay_record(Replay *replay, u32 input_bits);
+void replay_start_playback(const Replay *replay, SimState *state);
+b32 replay_next_input(Replay *replay, u32 *input_bits);
+
+i32 replay_encoded_size(const Replay *replay);
+i32 replay_encode(const Replay *replay, void *buffer, i32 size);
+b32 replay_decode(Replay *replay, void *data, i32 size);
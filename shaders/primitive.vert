@@ -1,4 +1,5 @@
 #version 330 core
+// Vertex in renderer.c: i16 pixel position, normalized u16 uv, RGBA8 color
 layout (location = 0) in vec2 pos;
 layout (location = 2) in vec4 color;
 
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec2 corner;
+layout (location = 1) in vec2 pos;
+layout (location = 2) in vec4 atlas_rect;
+layout (location = 3) in vec4 color;
+
+uniform mat4 ident_matrix;
+uniform mat4 trans_matrix;
+uniform mat3 texture_trans_matrix;
+uniform sampler2D sample_tex;
+out vec4 vertexColor;
+out vec2 texUV;
+
+void main()
+{
+    vec2 offset = corner * atlas_rect.zw;
+    gl_Position = trans_matrix * ident_matrix * vec4(pos + offset, -1.0, 1.0);
+    vertexColor = color;
+    vec2 uv = (atlas_rect.xy + offset) / vec2(textureSize(sample_tex, 0));
+    uv.y = 1.0 - uv.y;
+    vec3 texture_uv = texture_trans_matrix * vec3(uv, 1);
+    texUV = texture_uv.xy;
+}
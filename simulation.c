@@ -0,0 +1,569 @@
+#include "basic.h"
+#include "simulation.h"
+#include "profiler.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Using Super Rotation System
+
+#define PieceRow(A, B, C, D) (u16)((A) | (B) << 1 | (C) << 2 | (D) << 3)
+
+// Every orientation is precomputed, rotating right one quarter turn per
+// entry inside the piece's side x side box.
+const PieceShape PieceShapes[PIECE_COUNT][4] = {
+    { // Line
+        {.box = {0, 1, 4, 1}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 1, 1),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {2, 0, 1, 4}, .rows = {
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 0, 1, 0),
+        }},
+        {.box = {0, 2, 4, 1}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 1, 1),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 1, 4}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+        }},
+    },
+    { // Block
+        {.box = {0, 0, 2, 2}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 2}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 2}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 2}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+    { // Piramid
+        {.box = {0, 0, 3, 2}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 1, 3, 2}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+    { // LeftL
+        {.box = {0, 0, 3, 2}, .rows = {
+            PieceRow(1, 0, 0, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 1, 3, 2}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+    { // RightL
+        {.box = {0, 0, 3, 2}, .rows = {
+            PieceRow(0, 0, 1, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 1, 3, 2}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 1, 0),
+            PieceRow(1, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 3}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+    { // LeftZ
+        {.box = {0, 0, 3, 2}, .rows = {
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 2, 3}, .rows = {
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 1, 3, 2}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(1, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+    { // RightZ
+        {.box = {0, 0, 3, 2}, .rows = {
+            PieceRow(0, 1, 1, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {1, 0, 2, 3}, .rows = {
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(0, 0, 1, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 1, 3, 2}, .rows = {
+            PieceRow(0, 0, 0, 0),
+            PieceRow(0, 1, 1, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+        {.box = {0, 0, 2, 3}, .rows = {
+            PieceRow(1, 0, 0, 0),
+            PieceRow(1, 1, 0, 0),
+            PieceRow(0, 1, 0, 0),
+            PieceRow(0, 0, 0, 0),
+        }},
+    },
+};
+
+const i32 PieceSides[PIECE_COUNT] = {4, 2, 3, 3, 3, 3, 3};
+
+// Same splitmix64 as basic.h, but owned by the randomizer so every game
+// can be replayed from its seed
+static u64 randomizer_u64(PieceRandomizer *randomizer){
+    randomizer->rng += 0x9e3779b97f4a7c15;
+    u64 z = randomizer->rng;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+void piece_randomizer_init(PieceRandomizer *randomizer, u64 seed){
+    assert(seed != 0);
+    randomizer->rng = seed;
+    for(i32 i = 0; i < 16; i++) randomizer_u64(randomizer);
+    for(i32 i = 0; i < array_size(randomizer->history); i++) randomizer->history[i] = -1;
+    randomizer->history_index = 0;
+}
+
+Piece piece_randomizer_next(PieceRandomizer *randomizer){
+    i32 *history = randomizer->history;
+    i32 roll = 0;
+
+    for(i32 j = 0; j < array_size(randomizer->history); j++){
+        roll = (i32)((randomizer_u64(randomizer) & MAXu32) % PIECE_COUNT);
+        b32 is_new = true;
+        for(i32 i = 0; i < array_size(randomizer->history); i++){
+            if(roll == history[i]){
+                is_new = false;
+                break;
+            }
+        }
+        if(is_new) break;
+    }
+
+    history[randomizer->history_index++] = roll;
+    randomizer->history_index %= array_size(randomizer->history);
+
+    return (Piece){.type = (u8)(roll + 1), .rotation = 0};
+}
+
+void board_clear(Board *board){
+    for(i32 y = 0; y < GridH; y++)
+        board->rows[y] = GridWallMask;
+    set_zero(board->colors, sizeof(board->colors));
+    set_zero(board->row_fill, sizeof(board->row_fill));
+    set_zero(board->columns, sizeof(board->columns));
+}
+
+// Rebuilds the counters from the row masks, for boards that come from a file
+void board_update_counters(Board *board){
+    set_zero(board->columns, sizeof(board->columns));
+    for(i32 y = 0; y < GridH; y++){
+        u32 cells = board->rows[y] & (u16)~GridWallMask;
+        board->row_fill[y] = (u8)popcount32(cells);
+        for(i32 x = 0; x < GridW; x++){
+            if(cells & (1u << (x + GridPad)))
+                board->columns[x] |= 1u << y;
+        }
+    }
+}
+
+void board_set_cell(Board *board, i32 x, i32 y, i32 type){
+    assert(x >= 0 && x < GridW && y >= 0 && y < GridH);
+    u16 bit = (u16)(1 << (x + GridPad));
+    b32 filled = (board->rows[y] & bit) != 0;
+    if(type && !filled){
+        board->rows[y] |= bit;
+        board->row_fill[y]++;
+        board->columns[x] |= 1u << y;
+    } else if(!type && filled){
+        board->rows[y] &= (u16)~bit;
+        board->row_fill[y]--;
+        board->columns[x] &= ~(1u << y);
+    }
+    board->colors[y][x] = (u8)type;
+}
+
+// Returns the rows the piece completed, only the rows it touched are checked
+u32 board_set_piece(Board *board, i32 x, i32 y, Piece p){
+    u32 full = 0;
+    const PieceShape *shape = piece_shape(p);
+    for(i32 i = shape->box.y; i < shape->box.y + shape->box.h; i++){
+        i32 p_y = y + i;
+        if(p_y < 0 || p_y >= GridH) continue;
+        for(i32 j = shape->box.x; j < shape->box.x + shape->box.w; j++){
+            i32 p_x = x + j;
+            if(!piece_cell(p, j, i) || p_x < 0 || p_x >= GridW) continue;
+            board_set_cell(board, p_x, p_y, p.type);
+        }
+        if(board->row_fill[p_y] == GridW) full |= 1u << p_y;
+    }
+    return full;
+}
+
+// Bit y set when row y is full. Rows already hold their walls, so a full
+// row is exactly GridRowFull and the whole board is three vector compares.
+u32 board_full_rows(const Board *board){
+#if defined(__SSE2__) || defined(_M_X64)
+    assert(GridH == 20); // update the loads below
+    const __m128i full = _mm_set1_epi16((i16)GridRowFull);
+    __m128i r0 = _mm_loadu_si128((const __m128i *)&board->rows[0]);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)&board->rows[8]);
+    __m128i r2 = _mm_loadl_epi64((const __m128i *)&board->rows[16]);
+    // 16 bit compares packed down to one byte per row, then one bit per row
+    __m128i lo = _mm_packs_epi16(_mm_cmpeq_epi16(r0, full), _mm_cmpeq_epi16(r1, full));
+    __m128i hi = _mm_packs_epi16(_mm_cmpeq_epi16(r2, full), _mm_setzero_si128());
+    return (u32)_mm_movemask_epi8(lo) | ((u32)_mm_movemask_epi8(hi) & 0xf) << 16;
+#else
+    u32 mask = 0;
+    for(i32 y = 0; y < GridH; y++)
+        mask |= (u32)(board->rows[y] == GridRowFull) << y;
+    return mask;
+#endif
+}
+
+// Drops the rows in mask and moves everything above them down in a single
+// bottom up pass, each surviving row is copied at most once
+void board_remove_rows(Board *board, u32 mask){
+    if(!mask) return;
+    i32 write = GridH - 1;
+    for(i32 y = GridH - 1; y >= 0; y--){
+        if(mask & (1u << y)) continue;
+        if(write != y){
+            board->rows[write] = board->rows[y];
+            board->row_fill[write] = board->row_fill[y];
+            memcpy(board->colors[write], board->colors[y], sizeof(board->colors[write]));
+        }
+        write--;
+    }
+    for(i32 y = write; y >= 0; y--){
+        board->rows[y] = GridWallMask;
+        board->row_fill[y] = 0;
+    }
+    set_zero(board->colors, sizeof(board->colors[0]) * (write + 1));
+
+    // Same thing on the column bits, top row first so the lower
+    // indices in mask stay valid after each shift
+    for(u32 rows = mask; rows; rows &= rows - 1){
+        i32 y = ctz32(rows);
+        u32 above = (1u << y) - 1;
+        for(i32 x = 0; x < GridW; x++){
+            u32 column = board->columns[x];
+            board->columns[x] = (column & ~(above | (1u << y))) | (column & above) << 1;
+        }
+    }
+}
+
+// Removes full lines right away, returns how many were removed
+i32 board_clear_lines(Board *board){
+    u32 mask = board_full_rows(board);
+    board_remove_rows(board, mask);
+    return popcount32(mask);
+}
+
+void sim_clear_grid(SimState *state){
+    board_clear(&state->grid);
+    state->full_rows = 0;
+}
+
+// For boards from outside the simulation, full rows clear on the next tick
+void sim_set_board(SimState *state, const Board *board){
+    state->grid = *board;
+    board_update_counters(&state->grid);
+    state->full_rows = board_full_rows(&state->grid);
+}
+
+void sim_set_cell(SimState *state, i32 x, i32 y, i32 type){
+    board_set_cell(&state->grid, x, y, type);
+    if(state->grid.row_fill[y] == GridW) state->full_rows |= 1u << y;
+    else                                 state->full_rows &= ~(1u << y);
+}
+
+void sim_set_piece(SimState *state, i32 x, i32 y, Piece p){
+    state->full_rows |= board_set_piece(&state->grid, x, y, p);
+}
+
+b32 sim_piece_collided(const SimState *state, i32 x, i32 y, Piece p){
+    return board_piece_collided(&state->grid, x, y, p);
+}
+
+void sim_spawn_next_piece(SimState *state){
+    state->aim.piece = state->aim.next_piece;
+    state->aim.next_piece = piece_randomizer_next(&state->randomizer);
+    state->aim.piece_setted = false;
+    state->piece_statistics[state->aim.piece.type - 1]++;
+    state->piece_count++;
+
+    state->aim.x = piece_spawn_x(state->aim.piece);
+    state->aim.y = 0;
+}
+
+void sim_restart(SimState *state, b32 clear_grid){
+    if(clear_grid)
+        sim_clear_grid(state);
+    set_zero(state->piece_statistics, sizeof(state->piece_statistics));
+    state->aim.next_piece = piece_randomizer_next(&state->randomizer);
+    sim_spawn_next_piece(state);
+    state->gravity_count = 0;
+    state->score = 0;
+    state->game_over = false;
+    state->streak_on = false;
+    state->gape_queue.count = 0;
+}
+
+void sim_init(SimState *state, u64 seed){
+    assert(seed != 0);
+    set_zero(state, sizeof(*state));
+    state->seed = seed;
+    piece_randomizer_init(&state->randomizer, seed);
+    state->falling = true;
+    sim_restart(state, true);
+}
+
+static u32 move_piece(SimState *state, u32 input, u32 pressed){
+    u32 events = 0;
+
+    if(pressed & SIM_INPUT_ROTATE_LEFT){
+        Piece new_pos = rotate_piece(state->aim.piece, -1);
+        if(!sim_piece_collided(state, state->aim.x, state->aim.y, new_pos)){
+            state->aim.piece = new_pos;
+            events |= SIM_EVENT_ROTATE;
+        }
+    } else if(pressed & SIM_INPUT_ROTATE_RIGHT){
+        Piece new_pos = rotate_piece(state->aim.piece, 1);
+        if(!sim_piece_collided(state, state->aim.x, state->aim.y, new_pos)){
+            state->aim.piece = new_pos;
+            events |= SIM_EVENT_ROTATE;
+        }
+    }
+
+    if(pressed & SIM_INPUT_LEFT){
+        state->move_key = SIM_INPUT_LEFT;
+        state->move_direction = -1;
+    }
+    if(pressed & SIM_INPUT_RIGHT){
+        state->move_key = SIM_INPUT_RIGHT;
+        state->move_direction = 1;
+    }
+
+    if(input & state->move_key){
+        if(state->move_delay >= SIM_MOVE_DELAY_TICKS){
+            i32 new_pos = state->aim.x + state->move_direction;
+            if(!sim_piece_collided(state, new_pos, state->aim.y, state->aim.piece)){
+                state->aim.x = new_pos;
+                events |= SIM_EVENT_MOVE;
+            }
+            state->move_delay = 0;
+        }
+    } else {
+        state->move_key = 0;
+    }
+    if(state->move_delay < SIM_MOVE_DELAY_TICKS)
+        state->move_delay++;
+
+    if(input & SIM_INPUT_DOWN)
+        state->gravity_count += SIM_SOFT_DROP_SPEED;
+
+    if(state->falling)
+        state->gravity_count++;
+    if(state->gravity_count >= SIM_MOVE_DOWN_TICKS){
+        state->aim.y += 1;
+        state->gravity_count = 0;
+        if(sim_piece_collided(state, state->aim.x, state->aim.y, state->aim.piece)){
+            sim_set_piece(state, state->aim.x, state->aim.y - 1, state->aim.piece);
+            state->aim.piece_setted = true;
+            events |= SIM_EVENT_LOCK;
+        }
+    }
+    return events;
+}
+
+static u32 update_grid(SimState *state){
+    u32 events = 0;
+    Board *grid = &state->grid;
+
+    if(state->streak_on){
+        if(state->streak_timer <= 0){
+            state->streak_on = false;
+        } else {
+            state->streak_timer--;
+            return events;
+        }
+    } else {
+        // Queue complete lines, the tetris animation draws from the queue
+        i32 streak = 0;
+        u32 full = state->full_rows;
+        state->full_rows = 0;
+        for(i32 y = 0; full; y++, full >>= 1){
+            if(full & 1){
+                streak++;
+                state->gape_queue.buffer[state->gape_queue.count++] = y;
+            }
+        }
+
+        if(streak){
+            state->score += streak * SIM_LINE_SCORE;
+
+            if(streak >= 4){
+                state->streak_timer = SIM_STREAK_TICKS;
+                state->streak_on = true;
+                return SIM_EVENT_TETRIS;
+            }
+            events |= SIM_EVENT_SCORE;
+        }
+    }
+
+    // Push blocks down
+    u32 mask = 0;
+    for(i32 i = 0; i < state->gape_queue.count; i++)
+        mask |= 1u << state->gape_queue.buffer[i];
+    board_remove_rows(grid, mask);
+    state->gape_queue.count = 0;
+    return events;
+}
+
+u32 sim_step(SimState *state, u32 input_bits, i32 dt_ticks){
+    u32 events = 0;
+    for(i32 tick = 0; tick < dt_ticks; tick++){
+        u32 pressed = input_bits & ~state->last_input;
+        state->last_input = input_bits;
+        if(state->game_over) continue;
+
+        if(state->aim.piece_setted && !state->streak_on){
+            sim_spawn_next_piece(state);
+            if(sim_piece_collided(state, state->aim.x, state->aim.y, state->aim.piece)){
+                state->game_over = true;
+                events |= SIM_EVENT_GAME_OVER;
+                continue;
+            }
+        }
+
+        if(!state->streak_on)
+            events |= move_piece(state, input_bits, pressed);
+        PROFILE_BEGIN("update_grid");
+        events |= update_grid(state);
+        PROFILE_END();
+    }
+    return events;
+}
+
+// Moves the falling piece one step per entry without going through auto
+// repeat or gravity, for callers that already know the path (the bot).
+// Stops at the first move that would collide.
+u32 sim_apply_moves(SimState *state, const u8 *moves, i32 count){
+    u32 events = 0;
+    if(state->game_over || state->aim.piece_setted || state->streak_on) return events;
+
+    for(i32 i = 0; i < count; i++){
+        i32 x = state->aim.x, y = state->aim.y;
+        Piece piece = state->aim.piece;
+        switch(moves[i]){
+            case SIM_INPUT_LEFT:         x--; break;
+            case SIM_INPUT_RIGHT:        x++; break;
+            case SIM_INPUT_DOWN:         y++; break;
+            case SIM_INPUT_ROTATE_LEFT:  piece = rotate_piece(piece, -1); break;
+            case SIM_INPUT_ROTATE_RIGHT: piece = rotate_piece(piece, 1); break;
+            default: assert(!"Unknown move");
+        }
+        if(sim_piece_collided(state, x, y, piece)) break;
+        events |= (piece.rotation != state->aim.piece.rotation) ? SIM_EVENT_ROTATE : SIM_EVENT_MOVE;
+        state->aim.x = x;
+        state->aim.y = y;
+        state->aim.piece = piece;
+    }
+    return events;
+}
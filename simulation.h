@@ -0,0 +1,193 @@
+#pragma once
+
+// Game rules with no renderer, audio or OS dependency. Everything a game
+// needs lives in SimState and advances only through sim_step, so it can
+// run headless at whatever rate the caller wants.
+
+#include "basic.h"
+
+#define GridW 10
+#define GridH 20
+#define GridPad 3 // wall bits on each side of a row mask
+#define GridRowFull  0xffff
+#define GridWallMask ((u16)~(((1u << GridW) - 1) << GridPad))
+
+// Occupancy is kept as one bit mask per row with the walls already set,
+// so collision is a shift and an AND per piece row. Colors live apart.
+typedef struct{
+    u16 rows[GridH];
+    u8 colors[GridH][GridW];
+
+    // Kept in step with rows by the board_* functions so features don't
+    // need a scan. Anything that writes rows directly must call
+    // board_update_counters.
+    u8 row_fill[GridH];   // filled cells per row
+    u32 columns[GridW];   // bit y set when cell (x, y) is filled
+}Board;
+
+#define PIECE_COUNT 7
+
+typedef struct{
+    u8 type;     // 1 based, indexes PieceShapes[type - 1]
+    u8 rotation; // quarter turns to the right from the spawn orientation
+}Piece;
+
+typedef struct{
+    u16 rows[4]; // bit x set when column x is filled
+    struct{i8 x, y, w, h;}box; // bounding box of the filled cells
+}PieceShape;
+
+extern const PieceShape PieceShapes[PIECE_COUNT][4];
+extern const i32 PieceSides[PIECE_COUNT];
+
+static inline const PieceShape *piece_shape(Piece piece){
+    assert(piece.type >= 1 && piece.type <= PIECE_COUNT);
+    return &PieceShapes[piece.type - 1][piece.rotation & 3];
+}
+
+static inline b32 piece_cell(Piece piece, i32 x, i32 y){
+    return (piece_shape(piece)->rows[y] >> x) & 1;
+}
+
+static inline i32 piece_side(Piece piece){
+    return PieceSides[piece.type - 1];
+}
+
+// New pieces start centered on the top row
+static inline i32 piece_spawn_x(Piece piece){
+    return (GridW - piece_side(piece)) / 2;
+}
+
+static inline Piece rotate_piece(Piece piece, i32 dir){
+    piece.rotation = (u8)((piece.rotation + dir) & 3);
+    return piece;
+}
+
+// Row y of the board is rows[y * stride], so boards stored interleaved
+// (see battle.h) share the same test
+static inline b32 rows_piece_collided(const u16 *rows, i32 stride, i32 x, i32 y, Piece p){
+    const PieceShape *shape = piece_shape(p);
+    i32 left = x + shape->box.x;
+    if(left < 0 || left + shape->box.w > GridW) return true;
+    if(y + shape->box.y + shape->box.h > GridH) return true;
+
+    for(i32 i = shape->box.y; i < shape->box.y + shape->box.h; i++){
+        i32 p_y = y + i;
+        if(p_y < 0) continue;
+        u16 piece_row = (u16)(shape->rows[i] << (x + GridPad));
+        if(piece_row & rows[p_y * stride])
+            return true;
+    }
+    return false;
+}
+
+static inline b32 board_piece_collided(const Board *board, i32 x, i32 y, Piece p){
+    return rows_piece_collided(board->rows, 1, x, y, p);
+}
+
+static inline i32 board_column_height(const Board *board, i32 x){
+    u32 column = board->columns[x];
+    return column? GridH - ctz32(column) : 0;
+}
+
+// Empty cells below the top of the column
+static inline i32 board_column_holes(const Board *board, i32 x){
+    return board_column_height(board, x) - popcount32(board->columns[x]);
+}
+
+// Time
+
+#define SIM_TICK_RATE 240
+#define seconds_to_ticks(S) (i32)((S) * SIM_TICK_RATE + 0.5f)
+
+#define SIM_MOVE_DOWN_TICKS  seconds_to_ticks(0.65f)
+#define SIM_MOVE_DELAY_TICKS seconds_to_ticks(1.0f / 10.0f)
+#define SIM_STREAK_TICKS     seconds_to_ticks(1.0f)
+#define SIM_SOFT_DROP_SPEED  10 // gravity ticks added per tick while down is held
+
+#define SIM_LINE_SCORE 1000
+
+enum SimInputBits{
+    SIM_INPUT_LEFT         = 1 << 0,
+    SIM_INPUT_RIGHT        = 1 << 1,
+    SIM_INPUT_DOWN         = 1 << 2,
+    SIM_INPUT_ROTATE_LEFT  = 1 << 3,
+    SIM_INPUT_ROTATE_RIGHT = 1 << 4,
+};
+
+// Reported back from sim_step so the caller can play sounds and effects
+enum SimEventBits{
+    SIM_EVENT_MOVE      = 1 << 0,
+    SIM_EVENT_ROTATE    = 1 << 1,
+    SIM_EVENT_LOCK      = 1 << 2,
+    SIM_EVENT_SCORE     = 1 << 3,
+    SIM_EVENT_TETRIS    = 1 << 4,
+    SIM_EVENT_GAME_OVER = 1 << 5,
+};
+
+// Uniform pieces, rerolled up to four times to avoid the last four
+typedef struct{
+    u64 rng;
+    i32 history[4];
+    i32 history_index;
+}PieceRandomizer;
+
+void piece_randomizer_init(PieceRandomizer *randomizer, u64 seed);
+Piece piece_randomizer_next(PieceRandomizer *randomizer);
+
+typedef struct{
+    Board grid;
+
+    struct{
+        b32 piece_setted;
+        i32 x, y;
+        Piece piece;
+        Piece next_piece;
+    }aim;
+
+    i32 score;
+    b32 game_over;
+    b32 falling; // gravity on, only turned off by debug tools
+    i32 gravity_count;
+
+    // horizontal auto repeat
+    i32 move_delay;
+    i32 move_direction;
+    u32 move_key;
+
+    // lines waiting to be removed, kept while the tetris animation plays
+    b32 streak_on;
+    i32 streak_timer;
+    struct{
+        i32 buffer[GridH];
+        i32 count;
+    }gape_queue;
+
+    i32 piece_statistics[PIECE_COUNT];
+    i32 piece_count; // pieces spawned since sim_init
+    u32 full_rows;   // rows filled since the last update_grid
+
+    u32 last_input;
+    u64 seed;
+    PieceRandomizer randomizer;
+}SimState;
+
+void board_clear(Board *board);
+void board_update_counters(Board *board);
+void board_set_cell(Board *board, i32 x, i32 y, i32 type);
+u32 board_set_piece(Board *board, i32 x, i32 y, Piece piece);
+u32 board_full_rows(const Board *board);
+void board_remove_rows(Board *board, u32 mask);
+i32 board_clear_lines(Board *board);
+
+void sim_init(SimState *state, u64 seed);
+void sim_restart(SimState *state, b32 clear_grid);
+u32 sim_step(SimState *state, u32 input_bits, i32 dt_ticks);
+
+b32 sim_piece_collided(const SimState *state, i32 x, i32 y, Piece piece);
+void sim_set_piece(SimState *state, i32 x, i32 y, Piece piece);
+void sim_set_cell(SimState *state, i32 x, i32 y, i32 type);
+void sim_spawn_next_piece(SimState *state);
+void sim_clear_grid(SimState *state);
+void sim_set_board(SimState *state, const Board *board);
+u32 sim_apply_moves(SimState *state, const u8 *moves, i32 count);
@@ -10,6 +10,7 @@
 
 #include "basic.h"
 #include "engine.h"
+#include "profiler.h"
 
 #pragma comment (lib, "avrt")
 #pragma comment (lib, "ole32")
@@ -265,6 +266,7 @@ static void sound_update(SoundState *sound, size_t samples){
 }
 
 void update_sounds(T_AudioPlayer *state){
+	PROFILE_BEGIN("update_sounds");
 	WasapiAudio *audio = state->internals;
 	wasapi_lock_buffer(audio);
 	// write at least 100msec of samples into buffer (or whatever space available, whichever is smaller)
@@ -293,6 +295,7 @@ void update_sounds(T_AudioPlayer *state){
 
 	// mix sounds into output
 	wasapi_unlock_buffer(audio, write_count);
+	PROFILE_END();
 }
 
 void init_wasapi(WasapiAudio *audio){
@@ -453,10 +456,6 @@ typedef struct{
 	// i16 data[];
 }WaveFile;
 
-f32 lerp(f32 v0, f32 v1, f32 t) { // @Move
-	return (1.0f - t) * v0 + t * v1;
-}
-
 Sound load_wave_file(const char *file_name){
 	const WasapiAudio *audio = AudioState.internals;
 	i32 size;
@@ -11,6 +11,8 @@
 #include "opengl_api.h"
 #include "engine.h"
 #include "game.h"
+#include "render_backend.h"
+#include "profiler.h"
 
 #include "wasapi.c"
 
@@ -27,42 +29,40 @@ static void DrawBuffer(HWND window){
     ReleaseDC(window, hdc);
 }
 
-struct FileInfo{
-    void *file;
-    FILETIME last_write;
-};
+static HGLRC GLContext;
 
-void *get_file_handle(void *file_info){
-    struct FileInfo *info = file_info;
-    return info->file;
-}
-
-// TODO use this instead of this method: https://learn.microsoft.com/en-us/windows/win32/fileio/obtaining-directory-change-notifications
-b32 update_file_info(void *info_handle){
-    struct FileInfo *info = (struct FileInfo*)info_handle;
-    FILETIME old_last_write = info->last_write;
-    GetFileTime(info->file, NULL, NULL, &info->last_write);
-    return (CompareFileTime(&old_last_write, &info->last_write) != 0);
+// Render thread callbacks, see render_thread_create
+static void bind_gl_context(void *window){
+    HDC hdc = GetDC(window);
+    b32 result = wglMakeCurrent(hdc, GLContext);
+    assert(result);
+    ReleaseDC(window, hdc);
 }
 
-void *create_file_info(void *file){
-    struct FileInfo *info = os_memory_alloc(sizeof(struct FileInfo));
-    info->file = file;
-    GetFileTime(info->file, NULL, NULL, &info->last_write);
-    return info;
+static void present_frame(void *window){
+    DrawBuffer(window);
 }
 
-static void *GetAnyGLFuncAddress(const char *name)
+// NULL when the driver doesn't have it
+static void *GetOptionalGLFuncAddress(const char *name)
 {
     void *p = (void *)wglGetProcAddress(name);
     if(p == 0 || (p == (void*)0x1) || (p == (void*)0x2) || (p == (void*)0x3) || (p == (void*)-1)){
         HMODULE module = LoadLibraryA("opengl32.dll");
         p = (void *)GetProcAddress(module, name);
 
-        if(p == 0 || (p == (void*)0x1) || (p == (void*)0x2) || (p == (void*)0x3) || (p == (void*)-1)){
-            printf("%s\n", name);
-            assert(false);
-        }
+        if(p == 0 || (p == (void*)0x1) || (p == (void*)0x2) || (p == (void*)0x3) || (p == (void*)-1))
+            return NULL;
+    }
+    return p;
+}
+
+static void *GetAnyGLFuncAddress(const char *name)
+{
+    void *p = GetOptionalGLFuncAddress(name);
+    if(!p){
+        printf("%s\n", name);
+        assert(false);
     }
     return p;
 }
@@ -105,6 +105,7 @@ static void LoadOpenGLFunctions(void){
 
     // OPEN_GL_1_5
     glGenBuffers = GetAnyGLFuncAddress("glGenBuffers");
+    glDeleteBuffers = GetAnyGLFuncAddress("glDeleteBuffers");
 
     // GL_VERSION_2_0
     glCreateShader  = GetAnyGLFuncAddress("glCreateShader");
@@ -126,6 +127,7 @@ static void LoadOpenGLFunctions(void){
     glDisableVertexAttribArray = GetAnyGLFuncAddress("glDisableVertexAttribArray");
     glBufferData = GetAnyGLFuncAddress("glBufferData");
     glBufferSubData = GetAnyGLFuncAddress("glBufferSubData");
+    glGetBufferSubData = GetAnyGLFuncAddress("glGetBufferSubData");
     glUniform3fv = GetAnyGLFuncAddress("glUniform3fv");
     glUniform2f  = GetAnyGLFuncAddress("glUniform2f");
     glUniform1iv = GetAnyGLFuncAddress("glUniform1iv");
@@ -139,6 +141,14 @@ static void LoadOpenGLFunctions(void){
     glBlendEquationSeparate = GetAnyGLFuncAddress("glBlendEquationSeparate");
     glBlendFuncSeparate = GetAnyGLFuncAddress("glBlendFuncSeparate");
     glDrawArraysInstanced = GetAnyGLFuncAddress("glDrawArraysInstanced");
+    glVertexAttribDivisor = GetAnyGLFuncAddress("glVertexAttribDivisor");
+    glMapBufferRange = GetAnyGLFuncAddress("glMapBufferRange");
+    glUnmapBuffer    = GetAnyGLFuncAddress("glUnmapBuffer");
+    glFenceSync      = GetAnyGLFuncAddress("glFenceSync");
+    glClientWaitSync = GetAnyGLFuncAddress("glClientWaitSync");
+    glDeleteSync     = GetAnyGLFuncAddress("glDeleteSync");
+    glMultiDrawArrays = GetAnyGLFuncAddress("glMultiDrawArrays");
+    glBufferStorage  = GetOptionalGLFuncAddress("glBufferStorage"); // GL 4.4 or ARB_buffer_storage
     glGetStringi = GetAnyGLFuncAddress("glGetStringi");
     glGetStringi = GetAnyGLFuncAddress("glGetStringi");
     //glBindTextureUnit = GetAnyGLFuncAddress("glBindTextureUnit");
@@ -243,15 +253,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine,
     QueryPerformanceFrequency(&freq);
     timeBeginPeriod(time_caps.wPeriodMin);
 
-    engine_setup();
+    profiler_thread_name("main");
+    // GL objects are made here, after that the context belongs to the
+    // render thread, it submits and swaps while the next frame runs
+    RenderBackend *gl = gl_backend_create();
+    wglMakeCurrent(NULL, NULL);
+    GLContext = hrc;
+    RenderBackend *backend = render_thread_create(gl, bind_gl_context, present_frame, window);
+    engine_setup(backend);
 
     MSG msg = {0};
-    timer_start.QuadPart = 0;
+    QueryPerformanceCounter(&timer_start);
     while(GameRunning){
-        LARGE_INTEGER old_start = timer_start;
-        QueryPerformanceCounter(&timer_start);
-        FramesPerSec = (u32)(1000 / (1000 * (timer_start.QuadPart - old_start.QuadPart) / freq.QuadPart));
-
         while(PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)){
             TranslateMessage(&msg);
             DispatchMessage(&msg);
@@ -262,19 +275,26 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine,
         engine_update();
         update_sounds(&AudioState); // TODO move this to other thread?
         engine_process_input();
-        DrawBuffer(window);
 
         QueryPerformanceCounter(&timer_end);
-        i32 ms_elapsed = 1000 * (i32)((timer_end.QuadPart - timer_start.QuadPart) / freq.QuadPart);
+        i32 ms_elapsed = (i32)(1000 * (timer_end.QuadPart - timer_start.QuadPart) / freq.QuadPart);
         i32 time_left = TARGETFPS - ms_elapsed;
-
         if(time_left > 0){
+            PROFILE_BEGIN("sleep");
             Sleep(time_left);
-            ms_elapsed = TARGETFPS;
+            PROFILE_END();
+            QueryPerformanceCounter(&timer_end);
         }
-        TimeElapsed = (f32)ms_elapsed / 1000.0f;
+
+        // Measured from frame start to frame start, sleep included, so
+        // the game tick accumulator sees the real time that passed
+        f64 seconds_elapsed = (f64)(timer_end.QuadPart - timer_start.QuadPart) / (f64)freq.QuadPart;
+        TimeElapsed  = (f32)seconds_elapsed;
+        FramesPerSec = (u32)(1.0 / MAX(seconds_elapsed, 0.001));
+        timer_start  = timer_end;
     }
-    
+
+    render_thread_destroy(backend);
     return 0;
 }
 
@@ -430,7 +450,8 @@ u8* os_read_whole_file_handle(void* file_handle, i32 *bytes){
 
 u8* os_read_whole_file(const char *name, i32 *bytes){
     *bytes = 0;
-    HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    // sharing delete too, so an editor can rename over a file while we read it
+    HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
     if(file == INVALID_HANDLE_VALUE)
         return NULL;
 
@@ -445,8 +466,10 @@ u8* os_read_whole_file(const char *name, i32 *bytes){
     i32 result = ReadFile(file, (void*)buffer, file_size, &read, NULL);
     CloseHandle(file);
 
-    if(!result || read != file_size)
+    if(!result || read != file_size){
+        os_memory_free(buffer);
         return NULL;
+    }
 
     *bytes = file_size;
     return buffer;
@@ -468,11 +491,11 @@ b32 os_read_file(void *buffer, i32 bytes, const char *name){
     return (result != 0 && read == (DWORD)bytes);
 }
 
-char* os_font_path(char *buffer, u32 size, const char *append){
+char* os_font_path(char *buffer, u32 size, const char *font_name){
     buffer[0] = 0;
     ExpandEnvironmentStringsA("%windir%", buffer, size);
     assert(buffer[0]);
-    i32 result = strcat_s(buffer, size, append) == 0;
+    i32 result = strcat_s(buffer, size, "\\Fonts\\") == 0 && strcat_s(buffer, size, font_name) == 0;
     assert(result);
     return buffer;
 }